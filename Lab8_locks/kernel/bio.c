@@ -22,11 +22,41 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "memstat.h"
 
 #define BUCKETSIZE 13 // number of hashing buckets
 #define BUFFERSIZE 5 // number of available buckets per bucket
 
 extern uint ticks; // system time clock
+
+// 块设备开关：按 dev 找到驱动的读写函数，ROOTDEV 是 virtio 磁盘。
+static void (*bdevsw[NBDEV])(struct buf*, int);
+
+void
+bdevregister(uint dev, void (*rw)(struct buf*, int))
+{
+  if(dev >= NBDEV)
+    panic("bdevregister");
+  bdevsw[dev] = rw;
+}
+
+// dev 上有没有驱动
+int
+bdevok(uint dev)
+{
+  return dev == ROOTDEV || (dev < NBDEV && bdevsw[dev] != 0);
+}
+
+static void
+bdevrw(struct buf *b, int write)
+{
+  if(b->dev < NBDEV && bdevsw[b->dev])
+    bdevsw[b->dev](b, write);
+  else if(b->dev == ROOTDEV)
+    virtio_disk_rw(b, write);
+  else
+    panic("bdevrw: no driver");
+}
 struct spinlock evict_lock;
 
 struct {
@@ -35,6 +65,50 @@ struct {
   struct buf buf[BUFFERSIZE];
 } bcache[BUCKETSIZE];
 
+// 二级缓存：被淘汰的干净块压缩后保存在 kalloc 分到的页中，
+// bread 未命中时先查这里，避免一次磁盘读。
+// 一个块不会同时在 bcache 和这里：bread 命中时把它从这里取走，
+// 块被淘汰时再放回来，所以这里的内容总是与磁盘一致。
+// 页按 FIFO 循环使用，每页内顺序追加压缩数据；内存紧张时
+// kalloc 通过 bzshrink 回收最旧的页。
+#define NZPAGE  64          // 最多占用的页数
+#define NZENT   2048        // 索引项个数
+#define ZHASH   127         // 索引哈希桶个数
+#define ZMAXLEN (BSIZE/2)   // 压缩后超过一半大小的块不保存
+#define NWORD   (BSIZE / sizeof(uint))
+
+struct zent {
+  uint dev;
+  uint blockno;
+  char *data;       // 压缩数据在页中的位置
+  ushort len;
+  short pg;         // 所在页
+  int next;         // 哈希链或空闲链，-1 结束
+};
+
+struct {
+  struct spinlock lock;
+  char *page[NZPAGE];
+  int npage;        // 已分配的页数
+  int cur;          // 正在追加的页
+  int used;         // 当前页已用字节数
+  struct zent ent[NZENT];
+  int head[ZHASH];
+  int free;
+  uint dropgen;     // bzdrop 的次数，见 bzevict
+  uint hits;        // bread 未命中 bcache 但命中二级缓存
+  uint misses;      // 两级都未命中，读磁盘
+} zcache;
+
+// O_DIRECT 使用的缓冲区。它们不挂在任何哈希桶上，
+// 因此大文件的流式读写不会把 bcache 中的热块挤出去。
+#define NDBUF 4
+
+static struct {
+  struct spinlock lock;
+  struct buf buf[NDBUF];
+} dcache;
+
 int
 hash(uint blockno)
 {
@@ -59,11 +133,294 @@ binit(void)
       bcache[i].head.next = b;
     }
   }
+
+  initlock(&zcache.lock, "zcache");
+  for (int i = 0; i < ZHASH; ++i)
+    zcache.head[i] = -1;
+  for (int i = 0; i < NZENT; ++i)
+    zcache.ent[i].next = i + 1 < NZENT ? i + 1 : -1;
+  zcache.free = 0;
+  zcache.cur = -1;
+
+  initlock(&dcache.lock, "dcache");
+  for (b = dcache.buf; b < dcache.buf+NDBUF; ++b) {
+    initsleeplock(&b->lock, "buffer");
+  }
+}
+
+// 以 32 位字为单位的游程编码。控制字节最高位为 1 表示后面的一个字
+// 重复 (c & 0x7f) + 1 次，为 0 表示后面有 (c & 0x7f) + 1 个原样的字。
+// 元数据块（位图、inode 块、间接块、目录）大多是 0 或重复的字。
+// dst 为 0 时只计算长度。Returns the encoded length.
+static int
+zenc(uint *src, char *dst)
+{
+  int i, j, len;
+
+  i = len = 0;
+  while(i < NWORD){
+    for(j = i + 1; j < NWORD && j - i < 128 && src[j] == src[i]; j++)
+      ;
+    if(j - i >= 2){
+      if(dst){
+        dst[len] = 0x80 | (j - i - 1);
+        memmove(dst + len + 1, &src[i], sizeof(uint));
+      }
+      len += 1 + sizeof(uint);
+    } else {
+      for(j = i + 1; j < NWORD && j - i < 128; j++){
+        if(j + 1 < NWORD && src[j] == src[j+1])
+          break;
+      }
+      if(dst){
+        dst[len] = j - i - 1;
+        memmove(dst + len + 1, &src[i], (j - i) * sizeof(uint));
+      }
+      len += 1 + (j - i) * sizeof(uint);
+    }
+    i = j;
+  }
+  return len;
+}
+
+static void
+zdec(char *src, int len, uint *dst)
+{
+  int p, n;
+  uchar c;
+  uint w;
+
+  p = 0;
+  while(p < len){
+    c = src[p++];
+    n = (c & 0x7f) + 1;
+    if(c & 0x80){
+      memmove(&w, src + p, sizeof(uint));
+      p += sizeof(uint);
+      while(n-- > 0)
+        *dst++ = w;
+    } else {
+      memmove(dst, src + p, n * sizeof(uint));
+      p += n * sizeof(uint);
+      dst += n;
+    }
+  }
+}
+
+// 以下函数要求持有 zcache.lock。
+
+static int
+zfind(uint dev, uint blockno)
+{
+  int i;
+
+  for(i = zcache.head[blockno % ZHASH]; i >= 0; i = zcache.ent[i].next){
+    if(zcache.ent[i].dev == dev && zcache.ent[i].blockno == blockno)
+      return i;
+  }
+  return -1;
+}
+
+static void
+zremove(int i)
+{
+  int *pp;
+
+  for(pp = &zcache.head[zcache.ent[i].blockno % ZHASH]; *pp != i; pp = &zcache.ent[*pp].next)
+    ;
+  *pp = zcache.ent[i].next;
+  zcache.ent[i].data = 0;
+  zcache.ent[i].next = zcache.free;
+  zcache.free = i;
+}
+
+// 使第 pg 页中的所有块失效，以便复用或释放这一页。
+static void
+zrecycle(int pg)
+{
+  int i;
+
+  for(i = 0; i < NZENT; i++){
+    if(zcache.ent[i].pg == pg && zcache.ent[i].data != 0)
+      zremove(i);
+  }
+}
+
+// 切换到下一页继续追加：没有分配过的槽位尝试分配新页，
+// 否则回收其中最旧的数据。Returns 0 if no page is available.
+// 为 kalloc 放过锁期间别人可能已经换了页，此时不动 cur 和 used，
+// 由调用者重新检查当前页放不放得下。
+static int
+znextpage(void)
+{
+  char *p;
+  int pg, cur;
+
+  cur = zcache.cur;
+  pg = (cur + 1) % NZPAGE;
+  if(zcache.page[pg] == 0){
+    // 不能持有 zcache.lock 调用 kalloc：kalloc 缺页时会回调 bzshrink
+    release(&zcache.lock);
+    p = kalloc_tag(KM_BCACHE);
+    acquire(&zcache.lock);
+    if(p == 0)
+      return 0;
+    if(zcache.page[pg] != 0 || zcache.cur != cur){
+      kfree(p);
+      return 1;
+    }
+    zcache.page[pg] = p;
+    zcache.npage++;
+  } else {
+    zrecycle(pg);
+  }
+  zcache.cur = pg;
+  zcache.used = 0;
+  return 1;
+}
+
+// 保存一个被淘汰的干净块压缩后的 len 字节 z，z 为 0 时不保存。
+// 旧的副本总是被去掉；gen 之后有过 bzdrop 时块可能已被绕过 bcache
+// 改写，也不保存。
+static void
+bzstash(uint dev, uint blockno, char *z, int len, uint gen)
+{
+  int i;
+  struct zent *e;
+
+  acquire(&zcache.lock);
+  if((i = zfind(dev, blockno)) >= 0)
+    zremove(i);
+  if(z == 0 || zcache.dropgen != gen || zcache.free < 0)
+    goto out;
+  while(zcache.cur < 0 || zcache.used + len > PGSIZE){
+    if(!znextpage())
+      goto out;
+    // znextpage 可能暂时放过锁，期间别人可能放入了同一个块
+    if((i = zfind(dev, blockno)) >= 0)
+      zremove(i);
+    if(zcache.dropgen != gen || zcache.free < 0)
+      goto out;
+  }
+
+  i = zcache.free;
+  e = &zcache.ent[i];
+  zcache.free = e->next;
+  e->dev = dev;
+  e->blockno = blockno;
+  e->pg = zcache.cur;
+  e->data = zcache.page[zcache.cur] + zcache.used;
+  e->len = len;
+  memmove(e->data, z, len);
+  zcache.used += len;
+  e->next = zcache.head[blockno % ZHASH];
+  zcache.head[blockno % ZHASH] = i;
+out:
+  release(&zcache.lock);
+}
+
+// 从二级缓存取出块 b 的内容。Returns 1 on hit.
+static int
+bzload(struct buf *b)
+{
+  int i;
+
+  acquire(&zcache.lock);
+  if((i = zfind(b->dev, b->blockno)) < 0){
+    zcache.misses++;
+    release(&zcache.lock);
+    return 0;
+  }
+  zdec(zcache.ent[i].data, zcache.ent[i].len, (uint*)b->data);
+  zremove(i);
+  zcache.hits++;
+  release(&zcache.lock);
+  return 1;
+}
+
+// 块在磁盘上的内容被绕过 bcache 修改了，丢弃二级缓存中的副本。
+static void
+bzdrop(uint dev, uint blockno)
+{
+  int i;
+
+  acquire(&zcache.lock);
+  if((i = zfind(dev, blockno)) >= 0)
+    zremove(i);
+  zcache.dropgen++;
+  release(&zcache.lock);
+}
+
+static uint
+bzgen(void)
+{
+  uint gen;
+
+  acquire(&zcache.lock);
+  gen = zcache.dropgen;
+  release(&zcache.lock);
+  return gen;
+}
+
+// 缓冲区 b 即将被复用于别的块：干净的内容压缩后放入二级缓存。
+// refcnt 为 0 的块没有被日志 pin 住，一定是干净的。
+// 调用者已把 b 的 refcnt 置为 -1 并放开了所有自旋锁：b 仍保留原来的
+// 身份，但 bget 和 bcached 都会跳过它，所以内容不会变，可以在锁外压缩。
+// 这期间 bcached 找不到 b，同一块可能被 O_DIRECT 绕过 bcache 写入，
+// 所以 gen 必须在置 refcnt 为 -1 之前读取。
+static void
+bzevict(struct buf *b, uint gen)
+{
+  char z[ZMAXLEN];
+  int len;
+
+  if(!b->valid || (len = zenc((uint*)b->data, 0)) > ZMAXLEN){
+    bzstash(b->dev, b->blockno, 0, 0, gen);
+    return;
+  }
+  zenc((uint*)b->data, z);
+  bzstash(b->dev, b->blockno, z, len, gen);
+}
+
+// 内存紧张时由 kalloc 调用：释放二级缓存最旧的一页。
+// Returns 1 if a page was freed.
+int
+bzshrink(void)
+{
+  int pg, i;
+
+  acquire(&zcache.lock);
+  for(i = 1; i <= NZPAGE; i++){
+    pg = (zcache.cur + i) % NZPAGE;
+    if(zcache.page[pg] != 0)
+      break;
+  }
+  if(i > NZPAGE){
+    release(&zcache.lock);
+    return 0;
+  }
+  zrecycle(pg);
+  kfree(zcache.page[pg]);
+  zcache.page[pg] = 0;
+  zcache.npage--;
+  if(pg == zcache.cur)
+    zcache.cur = -1;
+  release(&zcache.lock);
+  return 1;
+}
+
+// 打印二级缓存的命中情况，由 procdump 调用。
+void
+bzstat(void)
+{
+  printf("bcache L2: %d pages, %d hits, %d misses\n",
+         zcache.npage, zcache.hits, zcache.misses);
 }
 
 // 未命中时利用LRU查找空闲块。成功返回查找到的块，失败报错；若查找到的块被其他进程使用了，返回0重新查找。
+// 返回的块 refcnt 为 -1，*genp 为预占时二级缓存的 dropgen。
 struct buf*
-select_victim(int buckno)
+select_victim(int buckno, uint *genp)
 {
   // 如果buckno的桶已满，把ticks最小的那个refcnt=0的块中的从桶中偷走
   uint least = 0xffffffff;
@@ -99,83 +456,126 @@ select_victim(int buckno)
   }
   // 预占：标记为“正在驱逐中”
   least_b->refcnt = -1;  // 其他线程看到 -1 会跳过
+  *genp = bzgen();
   release(&bcache[least_buck].lock);
 
   return least_b;
 }
 
+// 持有两个桶锁时按序号从小到大获取，避免死锁
+static void
+block2(int a, int b)
+{
+  if (a > b) {
+    int t = a; a = b; b = t;
+  }
+  acquire(&bcache[a].lock);
+  if (b != a)
+    acquire(&bcache[b].lock);
+}
+
+static void
+unlock2(int a, int b)
+{
+  release(&bcache[a].lock);
+  if (b != a)
+    release(&bcache[b].lock);
+}
+
+// 在 buckno 桶中查找块，找到时增加引用计数。调用者持有桶锁。
+static struct buf*
+bfind(int buckno, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for (b = bcache[buckno].head.next; b != &bcache[buckno].head; b = b->next) {
+    // refcnt 为 -1 的块正在被驱逐，跳过
+    if (b->dev == dev && b->blockno == blockno && b->refcnt != -1) {
+      ++b->refcnt;
+      b->ticks = ticks;
+      return b;
+    }
+  }
+  return 0;
+}
+
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
 // In either case, return locked buffer.
+// 被复用的块先以原来的身份预占（refcnt 为 -1），在不持有任何
+// 自旋锁时放入二级缓存，然后才改成新的块。
 static struct buf*
 bget(uint dev, uint blockno)
 {
-  struct buf *b;
+  struct buf *b, *victim;
+  uint gen;
+  int vbuck;
 
   int buckno = hash(blockno);
   acquire(&bcache[buckno].lock);
 
   // Is the block already cached?
-  for (b = bcache[buckno].head.next; b != &bcache[buckno].head; b = b->next) {
-    if (b->dev == dev && b->blockno == blockno) {
-      if (b->refcnt == -1) {
-        // 正在被驱逐，跳过
-        continue;
-      }
-      ++b->refcnt;
-      b->ticks = ticks;
-      release(&bcache[buckno].lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  if ((b = bfind(buckno, dev, blockno)) != 0) {
+    release(&bcache[buckno].lock);
+    acquiresleep(&b->lock);
+    return b;
   }
 
   // Not cached.
   // Recycle the least recently used (LRU) unused buffer.
+  victim = 0;
   for(b = bcache[buckno].head.prev; b != &bcache[buckno].head; b = b->prev){
     if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache[buckno].lock);
-      acquiresleep(&b->lock);
-      return b;
+      b->refcnt = -1;
+      gen = bzgen();
+      victim = b;
+      break;
     }
   }
+  release(&bcache[buckno].lock);
 
   // 如果buckno的桶已满，把ticks最小的那个refcnt=0的块中的从桶中偷走
-  // 先从其他桶中查找块
-  release(&bcache[buckno].lock);
-  acquire(&evict_lock);
-  struct buf* least_b = 0;
-  while (least_b == 0) {
-    least_b = select_victim(buckno);
+  if (victim == 0) {
+    acquire(&evict_lock);
+    while ((victim = select_victim(buckno, &gen)) == 0)
+      ;
+    release(&evict_lock);
   }
 
-  int least_buck = hash(least_b->blockno);
-  release(&evict_lock);  // 安全释放
-  
+  // refcnt 为 -1，只有我们能访问它
+  bzevict(victim, gen);
 
+  // 同时持有 victim 所在的桶和 buckno 桶（按序号从小到大加锁），
+  // 检查放锁期间别人是否已经把这个块读进来了
+  vbuck = hash(victim->blockno);
+  block2(vbuck, buckno);
+  if ((b = bfind(buckno, dev, blockno)) != 0) {
+    // victim 作为空闲块留在原来的桶中。那个块可能又被读进了别的
+    // 缓冲区，清掉 dev 以免同一个块有两个缓冲区；设备号 0 不会被使用
+    victim->dev = 0;
+    victim->valid = 0;
+    victim->refcnt = 0;
+    unlock2(vbuck, buckno);
+    acquiresleep(&b->lock);
+    return b;
+  }
   // 开始偷桶，把要偷的块从桶中摘下来，放到buckno桶中head->prev的位置
-  acquire(&bcache[least_buck].lock);
-  least_b->prev->next = least_b->next;
-  least_b->next->prev = least_b->prev;
-  release(&bcache[least_buck].lock);
-
-  acquire(&bcache[buckno].lock);
-  least_b->dev = dev;
-  least_b->blockno = blockno;
-  least_b->valid = 0;
-  least_b->refcnt= 1;
-  least_b->ticks = ticks;
-  least_b->prev = bcache[buckno].head.prev;
-  least_b->next = &bcache[buckno].head;
-  bcache[buckno].head.prev->next = least_b;
-  bcache[buckno].head.prev = least_b;
-  release(&bcache[buckno].lock);
-  acquiresleep(&least_b->lock);
-  return least_b;
+  if (vbuck != buckno) {
+    victim->prev->next = victim->next;
+    victim->next->prev = victim->prev;
+    victim->prev = bcache[buckno].head.prev;
+    victim->next = &bcache[buckno].head;
+    bcache[buckno].head.prev->next = victim;
+    bcache[buckno].head.prev = victim;
+  }
+  victim->dev = dev;
+  victim->blockno = blockno;
+  victim->valid = 0;
+  victim->refcnt = 1;
+  victim->ticks = ticks;
+  unlock2(vbuck, buckno);
+  acquiresleep(&victim->lock);
+  return victim;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -186,7 +586,8 @@ bread(uint dev, uint blockno)
 
   b = bget(dev, blockno);
   if(!b->valid) {
-    virtio_disk_rw(b, 0);
+    if(!bzload(b))
+      bdevrw(b, 0);
     b->valid = 1;
   }
   return b;
@@ -198,18 +599,116 @@ bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  virtio_disk_rw(b, 1);
+  bdevrw(b, 1);
 }
 
-// Release a locked buffer.
-// Move to the head of the most-recently-used list.
+static int
+isdirect(struct buf *b)
+{
+  return b >= dcache.buf && b < dcache.buf+NDBUF;
+}
+
+// 若块已在 bcache 中，增加其引用计数并返回（未加睡眠锁）；否则返回 0。
+// 不会分配或驱逐任何缓冲区。
+static struct buf*
+bcached(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  int buckno = hash(blockno);
+  acquire(&bcache[buckno].lock);
+  for (b = bcache[buckno].head.next; b != &bcache[buckno].head; b = b->next) {
+    if (b->dev == dev && b->blockno == blockno && b->refcnt != -1) {
+      ++b->refcnt;
+      b->ticks = ticks;
+      release(&bcache[buckno].lock);
+      return b;
+    }
+  }
+  release(&bcache[buckno].lock);
+  return 0;
+}
+
+// Return a locked buf for direct I/O on the indicated block,
+// without reading it.  If the block is cached, the cached copy
+// is returned so that direct and cached accesses stay coherent;
+// otherwise a private direct buffer is used and bcache is untouched.
+struct buf*
+bget_direct(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  if ((b = bcached(dev, blockno)) != 0) {
+    acquiresleep(&b->lock);
+    return b;
+  }
+
+  acquire(&dcache.lock);
+  for (;;) {
+    for (b = dcache.buf; b < dcache.buf+NDBUF; ++b) {
+      if (b->refcnt == 0) {
+        b->dev = dev;
+        b->blockno = blockno;
+        b->valid = 0;
+        b->refcnt = 1;
+        release(&dcache.lock);
+        acquiresleep(&b->lock);
+        return b;
+      }
+    }
+    // direct 缓冲区都在使用中，等待 brelse 归还
+    sleep(&dcache, &dcache.lock);
+  }
+}
+
+// Like bread, but a block that is not already cached is read
+// into a direct buffer instead of evicting a cached one.
+struct buf*
+bread_direct(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget_direct(dev, blockno);
+  if(!b->valid) {
+    bdevrw(b, 0);
+    b->valid = 1;
+  }
+  return b;
+}
+
+// Write a buffer obtained from bget_direct/bread_direct.
+// A cached block goes through the log like any other write;
+// a direct buffer is written in place.  Caller is inside a
+// transaction and only uses this for file data blocks, so the
+// in-place write is ordered before the commit of the metadata
+// (block pointers, size) that refers to it.
 void
-brelse(struct buf *b)
+bwrite_direct(struct buf *b)
+{
+  if (isdirect(b)) {
+    bzdrop(b->dev, b->blockno);
+    bwrite(b);
+  } else
+    log_write(b);
+}
+
+// Release a locked buffer.
+// Move to the head of the most-recently-used list, or to the
+// tail if the caller does not expect to use the block again.
+static void
+brelse1(struct buf *b, int cold)
 {
   if(!holdingsleep(&b->lock))
     panic("brelse");
 
   releasesleep(&b->lock);
+  if (isdirect(b)) {
+    acquire(&dcache.lock);
+    b->refcnt--;
+    wakeup(&dcache);
+    release(&dcache.lock);
+    return;
+  }
   int buckno = hash(b->blockno);
   acquire(&bcache[buckno].lock);
   if (b->refcnt == -1) {
@@ -221,15 +720,72 @@ brelse(struct buf *b)
     // no one is waiting for it.
     b->next->prev = b->prev;
     b->prev->next = b->next;
-    b->next = bcache[buckno].head.next;
-    b->prev = &bcache[buckno].head;
-    bcache[buckno].head.next->prev = b;
-    bcache[buckno].head.next = b;
+    if (cold) {
+      // 用过即弃的块：放到桶尾并清零 ticks，成为下一个被复用/偷走的块
+      b->ticks = 0;
+      b->prev = bcache[buckno].head.prev;
+      b->next = &bcache[buckno].head;
+      bcache[buckno].head.prev->next = b;
+      bcache[buckno].head.prev = b;
+    } else {
+      b->next = bcache[buckno].head.next;
+      b->prev = &bcache[buckno].head;
+      bcache[buckno].head.next->prev = b;
+      bcache[buckno].head.next = b;
+    }
   }
   
   release(&bcache[buckno].lock);
 }
 
+void
+brelse(struct buf *b)
+{
+  brelse1(b, 0);
+}
+
+// 顺序扫描（FADV_SEQUENTIAL）读完的块用这个释放，避免扫描冲掉热块。
+void
+brelse_cold(struct buf *b)
+{
+  brelse1(b, 1);
+}
+
+// 把一个块读入 bcache 但不持有它，供预读使用。
+void
+bprefetch(uint dev, uint blockno)
+{
+  brelse(bread(dev, blockno));
+}
+
+// 丢弃一个缓存块（FADV_DONTNEED）。只处理 refcnt == 0 的块：
+// 被日志 pin 住或正在使用的块不动，因此被丢弃的块一定是干净的。
+void
+bdrop(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  int buckno = hash(blockno);
+  acquire(&bcache[buckno].lock);
+  for (b = bcache[buckno].head.next; b != &bcache[buckno].head; b = b->next) {
+    if (b->dev == dev && b->blockno == blockno) {
+      if (b->refcnt == 0) {
+        b->valid = 0;
+        b->ticks = 0;
+        b->next->prev = b->prev;
+        b->prev->next = b->next;
+        b->prev = bcache[buckno].head.prev;
+        b->next = &bcache[buckno].head;
+        bcache[buckno].head.prev->next = b;
+        bcache[buckno].head.prev = b;
+      }
+      break;
+    }
+  }
+  release(&bcache[buckno].lock);
+  bzdrop(dev, blockno);
+}
+
 void
 bpin(struct buf *b) {
 
@@ -0,0 +1,53 @@
+// 这里仅列出新增的声明，其余与原版 defs.h 相同
+
+struct memstat;
+
+// bio.c
+struct buf*     bget_direct(uint, uint);
+struct buf*     bread_direct(uint, uint);
+void            bwrite_direct(struct buf*);
+void            brelse_cold(struct buf*);
+void            bprefetch(uint, uint);
+void            bdrop(uint, uint);
+int             bzshrink(void);
+void            bzstat(void);
+void            bdevregister(uint, void (*)(struct buf*, int));
+int             bdevok(uint);
+
+// fdt.c
+int             fdtparse(uint64 *, int *);
+
+// kalloc.c
+void*           kalloc_tag(int);
+void            kmemstat(struct memstat *);
+void            kinithart(void);
+int             kallocn(void **, int, int);
+void            kfree_bulk(void **, int);
+void            krefinc(void *);
+int             krefcnt(void *);
+
+// ksm.c
+void            ksminit(void);
+int             ksmscan(int);
+int             ksmshrink(void);
+void            ksmstat(void);
+
+// shm.c
+void            shminit(void);
+int             shmget(int, int);
+uint64          shmat(int);
+int             shmdt(uint64);
+int             shmrm(int);
+
+// swap.c
+void            swapinit(void);
+int             cansleep(void);
+void*           swapalloc(int);
+int             swapfault(pagetable_t, uint64);
+int             swapout(int);
+void            swapdup(int);
+void            swapfree(int);
+
+// vm.c
+int             cowfault(pagetable_t, uint64);
+int             lazyfault(struct proc *, uint64);
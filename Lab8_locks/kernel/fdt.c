@@ -0,0 +1,112 @@
+// Flattened device tree, parsed just enough to learn
+// how much RAM there is and how many harts.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define FDT_MAGIC       0xd00dfeed
+#define FDT_BEGIN_NODE  1
+#define FDT_END_NODE    2
+#define FDT_PROP        3
+#define FDT_NOP         4
+#define FDT_END         9
+
+// 设备树中的整数都是大端序
+struct fdt_header {
+  uint magic;
+  uint totalsize;
+  uint off_dt_struct;
+  uint off_dt_strings;
+  uint off_mem_rsvmap;
+  uint version;
+  uint last_comp_version;
+  uint boot_cpuid_phys;
+  uint size_dt_strings;
+  uint size_dt_struct;
+};
+
+uint64 dtb_pa;  // physical address of the device tree, saved by entry.S
+
+static uint
+be32(const char *p)
+{
+  const uchar *b = (const uchar*)p;
+  return ((uint)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+static uint64
+be64(const char *p)
+{
+  return ((uint64)be32(p) << 32) | be32(p + 4);
+}
+
+// name 是 s 本身或 "s@单元地址"
+static int
+nodeis(const char *name, const char *s)
+{
+  int n = strlen(s);
+  return strncmp(name, s, n) == 0 && (name[n] == 0 || name[n] == '@');
+}
+
+// 在设备树中找从 KERNBASE 开始的 /memory 节点的大小，
+// 并统计 /cpus 下 cpu 节点的个数。
+// 假定根节点的 #address-cells 和 #size-cells 都是 2（QEMU virt 如此）。
+// Returns 0 on success, -1 if there is no usable device tree.
+int
+fdtparse(uint64 *memsize, int *ncpu)
+{
+  char *dtb = (char*)dtb_pa;
+  struct fdt_header *h = (struct fdt_header*)dtb;
+  char *p, *strs, *name;
+  int depth, inmem, incpus, len;
+  uint tok;
+
+  if(dtb == 0 || be32((char*)&h->magic) != FDT_MAGIC)
+    return -1;
+  p = dtb + be32((char*)&h->off_dt_struct);
+  strs = dtb + be32((char*)&h->off_dt_strings);
+
+  *memsize = 0;
+  *ncpu = 0;
+  depth = inmem = incpus = 0;
+  for(;;){
+    tok = be32(p);
+    p += 4;
+    switch(tok){
+    case FDT_BEGIN_NODE:
+      name = p;
+      depth++;
+      if(depth == 2){
+        inmem = nodeis(name, "memory");
+        incpus = nodeis(name, "cpus");
+      } else if(depth == 3 && incpus && nodeis(name, "cpu")){
+        (*ncpu)++;
+      }
+      p += (strlen(name) + 1 + 3) & ~3;
+      break;
+    case FDT_END_NODE:
+      if(depth == 2)
+        inmem = incpus = 0;
+      depth--;
+      break;
+    case FDT_PROP:
+      len = be32(p);
+      name = strs + be32(p + 4);
+      p += 8;
+      if(inmem && depth == 2 && len >= 16 && strncmp(name, "reg", 4) == 0 &&
+         be64(p) == KERNBASE)
+        *memsize = be64(p + 8);
+      p += (len + 3) & ~3;
+      break;
+    case FDT_NOP:
+      break;
+    case FDT_END:
+      return *memsize ? 0 : -1;
+    default:
+      return -1;
+    }
+  }
+}
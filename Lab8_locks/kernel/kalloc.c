@@ -7,6 +7,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "riscv.h"
+#include "memstat.h"
 #include "defs.h"
 
 void freerange(void *pa_start, void *pa_end);
@@ -14,23 +15,87 @@ void freerange(void *pa_start, void *pa_end);
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
-struct run {
-  struct run *next;
+// 空闲页的页号不再存放在空闲页自身，而是存放在专用的元数据页
+// （chunk）中，每个 CPU 一个 chunk 栈。分配和释放只访问栈顶 chunk
+// 的几个缓存行，空闲页的内容只由拿到它的调用者访问。
+// 栈顶 chunk 满时，被释放的页自己成为新的 chunk；
+// chunk 空了之后，它自己作为一页被分配出去。
+#define NPFN ((PGSIZE - 16) / sizeof(uint))
+
+struct chunk {
+  struct chunk *next;
+  int n;             // pfn[] 中的页数
+  uint pfn[NPFN];
 };
 
+#define PA2PFN(pa) ((uint)((uint64)(pa) >> PGSHIFT))
+#define PFN2PA(pfn) ((void*)((uint64)(pfn) << PGSHIFT))
+
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct chunk *top;
+  int nfree;         // 栈中的页数，包括 chunk 页自身
 } kmem[NCPU];
 
+// 每页的分配标签，和引用计数一样按物理页号索引。
+// 各标签的页数按 CPU 分别计数，不用加锁；某个 CPU 上的值可能为负，
+// 汇总后才是真实值。
+static uchar *ktag;
+static int kcount[NCPU][KM_NTAG];
+
+// 每个物理页的引用计数，按物理页号索引。
+// 用原子操作维护，不和 kmem 的锁相互嵌套。
+// 数组放在内核之后，大小随物理内存而定。
+struct {
+  int *cnt;
+} kref;
+
+#define PA2REF(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+
+uint64 memtop;          // 物理内存上界，启动时从设备树得到
+static uint64 memstart; // 第一个可分配的页
+static int nslice;      // 由几个 hart 分头释放物理内存
+
 void
 kinit()
 { 
+  uint64 size;
+  int ncpu;
+
   for (int i = 0; i < NCPU; ++i) {
     initlock(&kmem[i].lock, "kmem");
   }
-    
-  freerange(end, (void*)PHYSTOP);
+
+  // 没有设备树时退回到编译时的 PHYSTOP
+  memtop = PHYSTOP;
+  nslice = 1;
+  if (fdtparse(&size, &ncpu) == 0) {
+    memtop = KERNBASE + size;
+    if (memtop > KSTACK(NPROC))
+      memtop = KSTACK(NPROC);
+    if (ncpu >= 1 && ncpu <= NCPU)
+      nslice = ncpu;
+  }
+
+  kref.cnt = (int*)PGROUNDUP((uint64)end);
+  ktag = (uchar*)(kref.cnt + (memtop - KERNBASE) / PGSIZE);
+  memstart = PGROUNDUP((uint64)(ktag + (memtop - KERNBASE) / PGSIZE));
+
+  kinithart();
+}
+
+// 每个 hart 释放属于自己的一段物理内存，建立自己的空闲栈。
+// hart 0 在 kinit 中调用，其余 hart 在 main 中与 hart 0 并行调用。
+void
+kinithart(void)
+{
+  uint64 npages = (memtop - memstart) / PGSIZE;
+  int id = cpuid();
+
+  if (id >= nslice)
+    return;
+  freerange((void*)(memstart + npages * id / nslice * PGSIZE),
+            (void*)(memstart + npages * (id + 1) / nslice * PGSIZE));
 }
 
 void
@@ -38,8 +103,46 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE) {
+    // ktag 不在 BSS 中，启动时的内容不确定。
+    // 把页记作一个 KM_OTHER 页，kfree 时正好减掉
+    kref.cnt[PA2REF(p)] = 1;
+    ktag[PA2REF(p)] = KM_OTHER;
+    kcount[cpuid()][KM_OTHER]++;
     kfree(p);
+  }
+}
+
+// 把页 pa 压入 CPU id 的栈。调用者持有 kmem[id].lock。
+static void
+kpush(int id, void *pa)
+{
+  struct chunk *c = kmem[id].top;
+
+  kmem[id].nfree++;
+  if (c && c->n < NPFN) {
+    c->pfn[c->n++] = PA2PFN(pa);
+  } else {
+    c = (struct chunk*)pa;
+    c->n = 0;
+    c->next = kmem[id].top;
+    kmem[id].top = c;
+  }
+}
+
+// 从 CPU id 的栈弹出一页，栈空时返回 0。调用者持有 kmem[id].lock。
+static void*
+kpop(int id)
+{
+  struct chunk *c = kmem[id].top;
+
+  if (c == 0)
+    return 0;
+  kmem[id].nfree--;
+  if (c->n > 0)
+    return PFN2PA(c->pfn[--c->n]);
+  kmem[id].top = c->next;
+  return (void*)c;
 }
 
 // Free the page of physical memory pointed at by v,
@@ -49,68 +152,180 @@ freerange(void *pa_start, void *pa_end)
 void
 kfree(void *pa)
 {
-  struct run *r;
-
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+  if(((uint64)pa % PGSIZE) != 0 || (uint64)pa < memstart || (uint64)pa >= memtop)
     panic("kfree");
 
+  // 还有其他页表共享这一页时只减少引用计数
+  int n = __sync_sub_and_fetch(&kref.cnt[PA2REF(pa)], 1);
+  if(n > 0)
+    return;
+  if(n < 0)
+    panic("kfree: refcnt");
+
   push_off();
-  // Fill with junk to catch dangling refs.
-  memset(pa, 1, PGSIZE);
+  int id = cpuid();
+  kcount[id][ktag[PA2REF(pa)]]--;
+  acquire(&kmem[id].lock);
+  kpush(id, pa);
+  release(&kmem[id].lock);
+  pop_off();
+}
 
-  r = (struct run*)pa;
+// 一次释放 n 页，只对本 CPU 的栈加一次锁。用于拆除地址空间。
+void
+kfree_bulk(void **pages, int n)
+{
+  for (int i = 0; i < n; ++i) {
+    if(((uint64)pages[i] % PGSIZE) != 0 || (uint64)pages[i] < memstart || (uint64)pages[i] >= memtop)
+      panic("kfree_bulk");
+  }
 
+  push_off();
   int id = cpuid();
   acquire(&kmem[id].lock);
-  r->next = kmem[id].freelist;
-  kmem[id].freelist = r;
+  for (int i = 0; i < n; ++i) {
+    int m = __sync_sub_and_fetch(&kref.cnt[PA2REF(pages[i])], 1);
+    if (m > 0)
+      continue;
+    if (m < 0)
+      panic("kfree_bulk: refcnt");
+    kcount[id][ktag[PA2REF(pages[i])]]--;
+    kpush(id, pages[i]);
+  }
   release(&kmem[id].lock);
   pop_off();
 }
 
-// Allocate one 4096-byte page of physical memory.
-// Returns a pointer that the kernel can use.
-// Returns 0 if the memory cannot be allocated.
+// 本 CPU 没有空闲页时，从其他 CPU 整个偷走栈顶的 chunk，
+// 放到本 CPU 的栈上再从中分配一页。
 void*
 ksteal(int cpu)
 {
-  struct run *r;
+  struct chunk *c = 0;
+  void *pa;
+
   for (int i = 1; i < NCPU; ++i) {
     int next_cpu = (i + cpu) % NCPU;
     acquire(&kmem[next_cpu].lock);
-    r = kmem[next_cpu].freelist;
-    if (r) {
-      kmem[next_cpu].freelist = r->next;
+    c = kmem[next_cpu].top;
+    if (c) {
+      kmem[next_cpu].top = c->next;
+      kmem[next_cpu].nfree -= c->n + 1;
     }
     release(&kmem[next_cpu].lock);
-    if (r) {
+    if (c) {
       break;
     }
   }
-  return (void*)r;
+  if (c == 0)
+    return 0;
+
+  acquire(&kmem[cpu].lock);
+  c->next = kmem[cpu].top;
+  kmem[cpu].top = c;
+  kmem[cpu].nfree += c->n + 1;
+  pa = kpop(cpu);
+  release(&kmem[cpu].lock);
+  return pa;
 }
 
+// Allocate one 4096-byte page of physical memory.
+// Returns a pointer that the kernel can use.
+// Returns 0 if the memory cannot be allocated.
+// 不再填充垃圾数据，页的内容只由调用者访问。
+// tag 是 memstat.h 中的用途标签。
+void *
+kalloc_tag(int tag)
+{
+  void *pa;
+
+  push_off();
+  int id = cpuid();
+  acquire(&kmem[id].lock);
+  pa = kpop(id);
+  release(&kmem[id].lock);
+
+  if (pa == 0) {
+    pa = ksteal(id);
+  }
+
+  // 所有 CPU 都没有空闲页时，让 bcache 的二级缓存
+  // 和 KSM 的候选表还回页再试
+  while (pa == 0 && (bzshrink() || ksmshrink())) {
+    acquire(&kmem[id].lock);
+    pa = kpop(id);
+    release(&kmem[id].lock);
+  }
+
+  if(pa) {
+    kref.cnt[PA2REF(pa)] = 1;
+    ktag[PA2REF(pa)] = tag;
+    kcount[id][tag]++;
+  }
+
+  pop_off();
+  return pa;
+}
 
 void *
 kalloc(void)
 {
-  struct run *r;
+  return kalloc_tag(KM_OTHER);
+}
+
+// 一次分配最多 n 页放入 pages[]，本 CPU 的栈只加一次锁，
+// 不够时再逐页 kalloc。
+// Returns the number of pages allocated.
+int
+kallocn(void **pages, int n, int tag)
+{
+  void *pa;
+  int i = 0;
 
   push_off();
   int id = cpuid();
   acquire(&kmem[id].lock);
-  r = kmem[id].freelist;
-  if(r)
-    kmem[id].freelist = r->next;
+  while (i < n && (pa = kpop(id)) != 0) {
+    kref.cnt[PA2REF(pa)] = 1;
+    ktag[PA2REF(pa)] = tag;
+    kcount[id][tag]++;
+    pages[i++] = pa;
+  }
   release(&kmem[id].lock);
+  pop_off();
+
+  for (; i < n; ++i) {
+    if ((pages[i] = kalloc_tag(tag)) == 0)
+      break;
+  }
+  return i;
+}
 
-  if (r == 0) {
-    r = (struct run*)ksteal(id);
+// 汇总各 CPU 的计数
+void
+kmemstat(struct memstat *st)
+{
+  memset(st, 0, sizeof(*st));
+  st->total = (memtop - memstart) / PGSIZE;
+  for (int i = 0; i < NCPU; ++i) {
+    st->free += kmem[i].nfree;
+    for (int t = 0; t < KM_NTAG; ++t)
+      st->pages[t] += kcount[i][t];
   }
+}
 
-  if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+// 增加物理页 pa 的引用计数，用于 COW fork 共享页
+void
+krefinc(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (uint64)pa < memstart || (uint64)pa >= memtop)
+    panic("krefinc");
+  __sync_fetch_and_add(&kref.cnt[PA2REF(pa)], 1);
+}
 
-  pop_off();
-  return (void*)r;
+// 返回物理页 pa 当前的引用计数
+int
+krefcnt(void *pa)
+{
+  return __atomic_load_n(&kref.cnt[PA2REF(pa)], __ATOMIC_SEQ_CST);
 }
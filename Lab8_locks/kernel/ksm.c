@@ -0,0 +1,234 @@
+// Kernel same-page merging.
+//
+// 扫描睡眠中的进程的用户页，内容相同的页合并成同一个物理页。
+// 与 swap.c 相同，RUNNABLE 的进程可能正在 copyin/copyout 中使用
+// 某页的物理地址，合并会释放这一页，所以跳过。
+// 合并后的页在各页表中只读，可写页另打上 PTE_COW，
+// 写时由 cowfault 复制，从而解除共享。
+//
+// 表中保存已经写保护的候选页，按内容哈希索引，每项持有一个页引用。
+// 映射它的进程都放弃后，候选页只剩表的引用；内存不足时 kalloc
+// 通过 ksmshrink 释放这些页。
+// 脏位 PTE_D 置位的页最近被写过，清除脏位后跳过，
+// 等下一轮仍未被写时才作为候选，避免频繁变化的页反复写保护。
+//
+// 没有内核线程，扫描由用户态的 ksmd 通过 ksmscan 系统调用驱动。
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NKSM      512   // 候选页表项数
+#define KSMHASH   127
+#define KSMBATCH  256   // 一次系统调用最多扫描的页数
+
+extern struct proc proc[NPROC];
+extern uint ticks;
+
+struct kent {
+  uint64 pa;
+  uint hash;
+  struct kent *next;
+};
+
+// 锁的顺序是 p->lock -> ksm.lock：kalloc 可能在持有 p->lock 时
+// 调用 ksmshrink，所以不能持有 ksm.lock 去获取 p->lock。
+struct {
+  struct spinlock lock; // 保护候选表和统计
+  struct kent ent[NKSM];
+  struct kent *bucket[KSMHASH];
+  struct kent *free;
+  int nent;
+
+  struct sleeplock scan; // 一次只有一个扫描者，保护 hand 和 handva
+  int hand;             // 扫描到的进程
+  uint64 handva;        // 以及该进程中的虚拟地址
+
+  // 统计
+  uint scanned;
+  uint merged;
+  uint ticks;           // 扫描所花的时钟中断数
+} ksm;
+
+void
+ksminit(void)
+{
+  initlock(&ksm.lock, "ksm");
+  initsleeplock(&ksm.scan, "ksmscan");
+  for(int i = 0; i < NKSM; i++){
+    ksm.ent[i].next = ksm.free;
+    ksm.free = &ksm.ent[i];
+  }
+}
+
+static uint
+ksmhash(uint64 pa)
+{
+  uint64 *w = (uint64*)pa;
+  uint64 h = 0;
+
+  for(int i = 0; i < PGSIZE/sizeof(uint64); i++)
+    h = h * 31 + w[i];
+  return (uint)(h ^ (h >> 32));
+}
+
+// 回收只剩表自己引用的候选页。调用者持有 ksm.lock。
+// Returns the number of pages freed.
+static int
+ksmreclaim(void)
+{
+  struct kent **pp, *e;
+  int n = 0;
+
+  for(int i = 0; i < KSMHASH; i++){
+    for(pp = &ksm.bucket[i]; (e = *pp) != 0; ){
+      if(krefcnt((void*)e->pa) == 1){
+        *pp = e->next;
+        kfree((void*)e->pa);
+        e->next = ksm.free;
+        ksm.free = e;
+        ksm.nent--;
+        n++;
+      } else {
+        pp = &e->next;
+      }
+    }
+  }
+  return n;
+}
+
+// 内存紧张时由 kalloc 调用：释放只剩表自己引用的候选页。
+// Returns 1 if a page was freed.
+int
+ksmshrink(void)
+{
+  int n;
+
+  acquire(&ksm.lock);
+  n = ksmreclaim();
+  release(&ksm.lock);
+  return n > 0;
+}
+
+// 尝试合并 pte 映射的页。调用者持有页表所属进程的 p->lock 和 ksm.lock。
+// Returns 1 if the page was merged into an existing one.
+static int
+ksmpage(pte_t *pte)
+{
+  uint64 pa = PTE2PA(*pte);
+  uint flags = PTE_FLAGS(*pte);
+  struct kent *e;
+  uint h;
+
+  // 可写页改为只读 + COW，只读页保持只读
+  if(flags & PTE_W)
+    flags = (flags & ~PTE_W) | PTE_COW;
+
+  h = ksmhash(pa);
+  for(e = ksm.bucket[h % KSMHASH]; e; e = e->next){
+    if(e->hash == h && memcmp((void*)e->pa, (void*)pa, PGSIZE) == 0){
+      krefinc((void*)e->pa);
+      *pte = PA2PTE(e->pa) | flags;
+      kfree((void*)pa);
+      return 1;
+    }
+  }
+
+  if(ksm.free == 0)
+    ksmreclaim();
+  if((e = ksm.free) == 0)
+    return 0;
+  ksm.free = e->next;
+  ksm.nent++;
+  e->pa = pa;
+  e->hash = h;
+  e->next = ksm.bucket[h % KSMHASH];
+  ksm.bucket[h % KSMHASH] = e;
+  krefinc((void*)pa);
+  *pte = PA2PTE(pa) | flags;
+  return 0;
+}
+
+// 从上次停下的位置继续扫描至多 n 个用户页。
+// 只看睡眠中的进程里独占的页；COW 页可能正由所有者复制，跳过。
+// Returns the number of pages merged.
+int
+ksmscan(int n)
+{
+  struct proc *p;
+  pte_t *pte;
+  uint64 va;
+  uint t0;
+  int i, merged;
+
+  if(n > KSMBATCH)
+    n = KSMBATCH;
+
+  acquiresleep(&ksm.scan);
+  t0 = ticks;
+  merged = 0;
+  for(i = 0; n > 0 && i < NPROC; i++){
+    p = &proc[ksm.hand];
+    va = ksm.handva;
+    acquire(&p->lock);
+    acquire(&ksm.lock);
+    if(p->state == SLEEPING){
+      for(; va < p->sz && n > 0; va += PGSIZE){
+        if((pte = walk(p->pagetable, va, 0)) == 0)
+          continue;
+        if((*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U) || (*pte & PTE_COW))
+          continue;
+        if(krefcnt((void*)PTE2PA(*pte)) != 1)
+          continue;
+        n--;
+        ksm.scanned++;
+        if(*pte & PTE_D){
+          *pte &= ~PTE_D;
+          continue;
+        }
+        merged += ksmpage(pte);
+      }
+    } else {
+      va = p->sz;
+    }
+    release(&ksm.lock);
+    release(&p->lock);
+
+    if(va >= p->sz){
+      ksm.hand = (ksm.hand + 1) % NPROC;
+      ksm.handva = 0;
+    } else {
+      ksm.handva = va;
+    }
+  }
+  acquire(&ksm.lock);
+  ksm.merged += merged;
+  ksm.ticks += ticks - t0;
+  release(&ksm.lock);
+  releasesleep(&ksm.scan);
+  return merged;
+}
+
+// 打印合并统计。节省的页数是每个候选页除表和第一个映射者之外的引用数。
+void
+ksmstat(void)
+{
+  struct kent *e;
+  int saved = 0, r;
+
+  acquire(&ksm.lock);
+  for(int i = 0; i < KSMHASH; i++){
+    for(e = ksm.bucket[i]; e; e = e->next){
+      if((r = krefcnt((void*)e->pa)) > 2)
+        saved += r - 2;
+    }
+  }
+  printf("ksm: %d candidates, %d pages saved, %d scanned, %d merged, %d ticks\n",
+         ksm.nent, saved, ksm.scanned, ksm.merged, ksm.ticks);
+  release(&ksm.lock);
+}
@@ -0,0 +1,57 @@
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "defs.h"
+
+// 这里仅列出修改的函数
+
+volatile static int started = 0;
+volatile static int kinited = 0;
+
+// start() jumps here in supervisor mode on all CPUs.
+void
+main()
+{
+  if(cpuid() == 0){
+    consoleinit();
+    printfinit();
+    printf("\n");
+    printf("xv6 kernel is booting\n");
+    printf("\n");
+    kinit();         // physical page allocator
+    __sync_synchronize();
+    kinited = 1;     // let the other harts free their share of memory
+    kvminit();       // create kernel page table
+    kvminithart();   // turn on paging
+    procinit();      // process table
+    trapinit();      // trap vectors
+    trapinithart();  // install kernel trap vector
+    plicinit();      // set up interrupt controller
+    plicinithart();  // ask PLIC for device interrupts
+    binit();         // buffer cache
+    iinit();         // inode cache
+    fileinit();      // file table
+    virtio_disk_init(); // emulated hard disk
+    swapinit();      // swap area
+    ksminit();       // same-page merging
+    shminit();       // shared memory segments
+    userinit();      // first user process
+    __sync_synchronize();
+    started = 1;
+  } else {
+    while(kinited == 0)
+      ;
+    __sync_synchronize();
+    kinithart();      // free this hart's share of physical memory
+    while(started == 0)
+      ;
+    __sync_synchronize();
+    printf("hart %d starting\n", cpuid());
+    kvminithart();    // turn on paging
+    trapinithart();   // install kernel trap vector
+    plicinithart();   // ask PLIC for device interrupts
+  }
+
+  scheduler();        
+}
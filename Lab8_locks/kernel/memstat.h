@@ -0,0 +1,18 @@
+// 按子系统统计 kalloc 分出的页，由 memstat 系统调用返回。
+// 分配时用 kalloc_tag 标注用途。
+
+#define KM_OTHER     0  // 未标注的 kalloc
+#define KM_PGTBL     1  // 页表页
+#define KM_USER      2  // 用户内存
+#define KM_KSTACK    3  // 内核栈
+#define KM_TRAPFRAME 4  // trapframe
+#define KM_PIPE      5  // 管道缓冲区
+#define KM_BCACHE    6  // bcache 二级缓存
+#define KM_SHM       7  // 共享内存段
+#define KM_NTAG      8
+
+struct memstat {
+  uint64 total;            // 可分配的页数
+  uint64 free;             // 空闲页数
+  uint64 pages[KM_NTAG];   // 各用途占用的页数
+};
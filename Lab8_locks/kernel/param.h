@@ -0,0 +1,6 @@
+// 这里仅列出新增的定义，其余与原版 param.h 相同
+
+#define NSWAP        2048  // number of page slots in the swap area
+#define SWAPSTART    FSSIZE  // swap area follows the file system on disk;
+                             // fs.img must be padded to cover it
+#define NBDEV        4  // 块设备号上限，见 bio.c 的设备开关
@@ -0,0 +1,118 @@
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "memstat.h"
+
+#define PIPESIZE 512
+
+struct pipe {
+  struct spinlock lock;
+  char data[PIPESIZE];
+  uint nread;     // number of bytes read
+  uint nwrite;    // number of bytes written
+  int readopen;   // read fd is still open
+  int writeopen;  // write fd is still open
+};
+
+// 这里仅列出修改的函数
+
+int
+pipealloc(struct file **f0, struct file **f1)
+{
+  struct pipe *pi;
+
+  pi = 0;
+  *f0 = *f1 = 0;
+  if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
+    goto bad;
+  if((pi = (struct pipe*)kalloc_tag(KM_PIPE)) == 0)
+    goto bad;
+  pi->readopen = 1;
+  pi->writeopen = 1;
+  pi->nwrite = 0;
+  pi->nread = 0;
+  (*f0)->type = FD_PIPE;
+  (*f0)->readable = 1;
+  (*f0)->writable = 0;
+  (*f0)->pipe = pi;
+  (*f1)->type = FD_PIPE;
+  (*f1)->readable = 0;
+  (*f1)->writable = 1;
+  (*f1)->pipe = pi;
+  return 0;
+
+ bad:
+  if(pi)
+    kfree((char*)pi);
+  if(*f0)
+    fileclose(*f0);
+  if(*f1)
+    fileclose(*f1);
+  return -1;
+}
+
+// 用户页可能已被换出，读回时需要睡眠，所以和用户空间之间的拷贝
+// 都经过栈上的小缓冲区，在不持有 pi->lock 时进行。
+
+int
+pipewrite(struct pipe *pi, uint64 addr, int n)
+{
+  int i, j, m;
+  char buf[64];
+  struct proc *pr = myproc();
+
+  for(i = 0; i < n; i += m){
+    m = n - i < sizeof(buf) ? n - i : sizeof(buf);
+    if(copyin(pr->pagetable, buf, addr + i, m) == -1)
+      break;
+    acquire(&pi->lock);
+    for(j = 0; j < m; j++){
+      while(pi->nwrite == pi->nread + PIPESIZE){  //DOC: pipewrite-full
+        if(pi->readopen == 0 || pr->killed){
+          release(&pi->lock);
+          return -1;
+        }
+        wakeup(&pi->nread);
+        sleep(&pi->nwrite, &pi->lock);
+      }
+      pi->data[pi->nwrite++ % PIPESIZE] = buf[j];
+    }
+    wakeup(&pi->nread);
+    release(&pi->lock);
+  }
+  return i;
+}
+
+int
+piperead(struct pipe *pi, uint64 addr, int n)
+{
+  int i, m;
+  char buf[64];
+  struct proc *pr = myproc();
+
+  acquire(&pi->lock);
+  while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
+    if(pr->killed){
+      release(&pi->lock);
+      return -1;
+    }
+    sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
+  }
+  for(i = 0; i < n && pi->nread != pi->nwrite; i += m){  //DOC: piperead-copy
+    for(m = 0; m < sizeof(buf) && i + m < n && pi->nread != pi->nwrite; m++)
+      buf[m] = pi->data[pi->nread++ % PIPESIZE];
+    wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+    release(&pi->lock);
+    if(copyout(pr->pagetable, addr + i, buf, m) == -1)
+      return i;
+    acquire(&pi->lock);
+  }
+  release(&pi->lock);
+  return i;
+}
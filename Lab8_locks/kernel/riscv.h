@@ -0,0 +1,16 @@
+// 这里仅列出新增的定义，其余与原版 riscv.h 相同
+
+#define PTE_A (1L << 6)   // 访问位，由硬件置位
+#define PTE_D (1L << 7)   // 脏位，由硬件置位
+#define PTE_COW (1L << 8) // 写时复制页，使用 RSW 位
+#define PTE_SWAP (1L << 9) // 已换出到交换区，PTE_V 为 0，使用 RSW 位
+#define PTE_SHM (1L << 9)  // 共享内存页，与 PTE_SWAP 同一位，只在 PTE_V 置位时有此含义
+
+// level-1 叶子 PTE 映射的 2MB 大页
+#define MEGASIZE (1L << 21)
+#define MEGAROUNDUP(a)  (((a)+MEGASIZE-1) & ~(MEGASIZE-1))
+#define MEGAROUNDDOWN(a) (((a)) & ~(MEGASIZE-1))
+
+// 已换出页的 PTE 在 PPN 字段保存交换槽号
+#define SLOT2PTE(s) (((uint64)(s)) << 10)
+#define PTE2SLOT(pte) ((int)((pte) >> 10))
@@ -0,0 +1,204 @@
+// Shared memory segments.
+//
+// 段由若干 kalloc 页组成，页的物理地址记在一个索引页里。
+// 段本身对每页持有一个引用，每个映射再各持有一个引用，
+// 因此进程 exit、exec 或 sbrk 缩小时由 uvmunmap 照常 kfree 即可；
+// fork 时 uvmcopy 让子进程共享同一组页（可写，不走 COW）。
+// 段的第一页只剩段自己的引用时，说明已没有进程映射它，
+// 下一次 shmget 或 shmdt 时回收整个段。
+// 从未映射过的段（例如创建者还没 shmat 就退出了）不会这样回收，
+// 需要用 shmrm 删除：删除后 shmget 不再找到它，映射全部解除后回收。
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "memstat.h"
+#include "defs.h"
+
+#define NSHM     16
+#define SHMMAXPG (PGSIZE / sizeof(uint64))  // 一个索引页能记录的页数
+
+struct shmseg {
+  int key;
+  int npages;
+  int attached;   // 映射过才可能被回收
+  int removed;    // 已被 shmrm 删除，等待回收
+  uint64 *pages;  // 索引页，0 表示空闲
+};
+
+// 分配段时可能要换出页面，所以用睡眠锁
+struct {
+  struct sleeplock lock;
+  struct shmseg seg[NSHM];
+} shm;
+
+void
+shminit(void)
+{
+  initsleeplock(&shm.lock, "shm");
+}
+
+static void
+shmfree(struct shmseg *s)
+{
+  for(int i = 0; i < s->npages; i++)
+    kfree((void*)s->pages[i]);
+  kfree(s->pages);
+  s->pages = 0;
+}
+
+// 回收已没有进程映射的段。调用者持有 shm.lock。
+static void
+shmreap(void)
+{
+  struct shmseg *s;
+
+  for(s = shm.seg; s < &shm.seg[NSHM]; s++){
+    if(s->pages && (s->attached || s->removed) && krefcnt((void*)s->pages[0]) == 1)
+      shmfree(s);
+  }
+}
+
+// 返回键为 key 的段号，不存在时创建一个 size 字节、内容为零的段。
+// 页通过 kallocn 成批分配，段内各页不要求物理连续。
+int
+shmget(int key, int size)
+{
+  struct shmseg *s, *free = 0;
+  int i, n, npages;
+
+  npages = PGROUNDUP((uint64)size) / PGSIZE;
+  if(size <= 0 || npages > SHMMAXPG)
+    return -1;
+
+  acquiresleep(&shm.lock);
+  shmreap();
+  for(s = shm.seg; s < &shm.seg[NSHM]; s++){
+    if(s->pages && !s->removed && s->key == key){
+      releasesleep(&shm.lock);
+      return s - shm.seg;
+    }
+    if(s->pages == 0 && free == 0)
+      free = s;
+  }
+  if((s = free) == 0 || (s->pages = swapalloc(KM_SHM)) == 0){
+    releasesleep(&shm.lock);
+    return -1;
+  }
+  n = kallocn((void**)s->pages, npages, KM_SHM);
+  while(n < npages && (s->pages[n] = (uint64)swapalloc(KM_SHM)) != 0)
+    n++;
+  s->npages = n;
+  if(n < npages){
+    shmfree(s);
+    releasesleep(&shm.lock);
+    return -1;
+  }
+  for(i = 0; i < n; i++)
+    memset((void*)s->pages[i], 0, PGSIZE);
+  s->key = key;
+  s->attached = 0;
+  s->removed = 0;
+  releasesleep(&shm.lock);
+  return s - shm.seg;
+}
+
+// 把段 id 映射到当前进程地址空间的末尾。
+// Returns the virtual address, or -1 on error.
+uint64
+shmat(int id)
+{
+  struct proc *p = myproc();
+  struct shmseg *s;
+  uint64 va;
+  int i;
+
+  if(id < 0 || id >= NSHM)
+    return -1;
+  acquiresleep(&shm.lock);
+  s = &shm.seg[id];
+  va = PGROUNDUP(p->sz);
+  if(s->pages == 0 || s->removed || va + s->npages*PGSIZE >= TRAPFRAME)
+    goto bad;
+  for(i = 0; i < s->npages; i++){
+    if(mappages(p->pagetable, va + i*PGSIZE, PGSIZE, s->pages[i],
+                PTE_W|PTE_R|PTE_U|PTE_SHM) != 0){
+      uvmunmap(p->pagetable, va, i, 1);
+      goto bad;
+    }
+    krefinc((void*)s->pages[i]);
+  }
+  p->sz = va + s->npages*PGSIZE;
+  s->attached = 1;
+  releasesleep(&shm.lock);
+  return va;
+
+ bad:
+  releasesleep(&shm.lock);
+  return -1;
+}
+
+// 解除 va 处的段映射。段在地址空间末尾时同时缩小 p->sz，
+// 否则留下的空洞按普通堆页处理。
+int
+shmdt(uint64 va)
+{
+  struct proc *p = myproc();
+  struct shmseg *s;
+  pte_t *pte;
+  int i;
+
+  if(va % PGSIZE != 0 || va >= p->sz)
+    return -1;
+  if((pte = walk(p->pagetable, va, 0)) == 0 ||
+     (*pte & (PTE_V|PTE_SHM)) != (PTE_V|PTE_SHM))
+    return -1;
+
+  acquiresleep(&shm.lock);
+  for(s = shm.seg; s < &shm.seg[NSHM]; s++){
+    if(s->pages && s->pages[0] == PTE2PA(*pte))
+      break;
+  }
+  if(s == &shm.seg[NSHM] || va + s->npages*PGSIZE > p->sz)
+    goto bad;
+  for(i = 1; i < s->npages; i++){
+    pte = walk(p->pagetable, va + i*PGSIZE, 0);
+    if(pte == 0 || (*pte & PTE_V) == 0 || PTE2PA(*pte) != s->pages[i])
+      goto bad;
+  }
+  uvmunmap(p->pagetable, va, s->npages, 1);
+  if(va + s->npages*PGSIZE == p->sz)
+    p->sz = va;
+  shmreap();
+  releasesleep(&shm.lock);
+  return 0;
+
+ bad:
+  releasesleep(&shm.lock);
+  return -1;
+}
+
+// 删除段 id：之后 shmget 用同一个键会创建新段，已删除的段不能再映射。
+// 段的页在最后一个映射解除后回收，没有映射时立即回收。
+int
+shmrm(int id)
+{
+  struct shmseg *s;
+
+  if(id < 0 || id >= NSHM)
+    return -1;
+  acquiresleep(&shm.lock);
+  s = &shm.seg[id];
+  if(s->pages == 0 || s->removed){
+    releasesleep(&shm.lock);
+    return -1;
+  }
+  s->removed = 1;
+  shmreap();
+  releasesleep(&shm.lock);
+  return 0;
+}
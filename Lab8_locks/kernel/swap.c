@@ -0,0 +1,219 @@
+// Swap space for user pages.
+//
+// 内存不足时，把不在运行的进程中较冷的用户页写到磁盘上文件系统
+// 之后的交换区，PTE 中清除 PTE_V、置 PTE_SWAP，PPN 字段保存交换槽号；
+// 进程再次访问时在缺页处理中读回。
+//
+// 只从睡眠中的进程里挑页。RUNNABLE 的进程可能在 copyin/copyout
+// 的 walkaddr 和 memmove 之间被抢占，手里还拿着页的物理地址；
+// 而内核在 walkaddr 之后、用完那一页之前不会睡眠，
+// 所以 SLEEPING 的进程不会持有它的用户页。
+//
+// 交换槽带引用计数，fork 时父子进程共享同一个槽。
+// 换出一批页并写盘期间持有 swap.iolock，
+// 要读回其中某页的进程会在这把锁上等到写盘完成。
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "buf.h"
+#include "memstat.h"
+#include "defs.h"
+
+#define SWAPBATCH 8               // 一次最多换出的页数
+#define BPP       (PGSIZE / BSIZE) // 每页占用的磁盘块数
+
+extern struct proc proc[NPROC];
+
+struct {
+  struct spinlock lock;
+  uchar ref[NSWAP];        // 每个槽的引用数，0 表示空闲
+
+  struct sleeplock iolock; // 串行化交换区 I/O，保护下面的字段
+  struct buf buf;
+  int hand;                // clock 算法扫描到的进程
+  uint64 handva;           // 以及该进程中的虚拟地址
+} swap;
+
+void
+swapinit(void)
+{
+  initlock(&swap.lock, "swap");
+  initsleeplock(&swap.iolock, "swapio");
+}
+
+static int
+slotalloc(void)
+{
+  acquire(&swap.lock);
+  for(int i = 0; i < NSWAP; i++){
+    if(swap.ref[i] == 0){
+      swap.ref[i] = 1;
+      release(&swap.lock);
+      return i;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+// fork 时子进程共享一个已换出的页
+void
+swapdup(int slot)
+{
+  acquire(&swap.lock);
+  if(swap.ref[slot] == 0 || swap.ref[slot] == 255)
+    panic("swapdup");
+  swap.ref[slot]++;
+  release(&swap.lock);
+}
+
+void
+swapfree(int slot)
+{
+  acquire(&swap.lock);
+  if(swap.ref[slot] == 0)
+    panic("swapfree");
+  swap.ref[slot]--;
+  release(&swap.lock);
+}
+
+// 读写一个交换槽，调用者持有 swap.iolock
+static void
+swaprw(int slot, char *pa, int write)
+{
+  struct buf *b = &swap.buf;
+
+  for(int i = 0; i < BPP; i++){
+    b->dev = ROOTDEV;
+    b->blockno = SWAPSTART + slot*BPP + i;
+    if(write)
+      memmove(b->data, pa + i*BSIZE, BSIZE);
+    virtio_disk_rw(b, write);
+    if(!write)
+      memmove(pa + i*BSIZE, b->data, BSIZE);
+  }
+}
+
+// 用 clock 算法从睡眠中的进程里挑出至多 n 个冷页，写到交换区后释放。
+// 访问位 PTE_A 置位的页清除访问位后跳过；COW 共享的页不换出。
+// Returns the number of pages freed.
+int
+swapout(int n)
+{
+  uint64 pa[SWAPBATCH];
+  int slot[SWAPBATCH];
+  struct proc *p;
+  pte_t *pte;
+  uint64 va;
+  int i, s, got, full;
+
+  if(n > SWAPBATCH)
+    n = SWAPBATCH;
+
+  acquiresleep(&swap.iolock);
+  got = full = 0;
+  // 最多扫两圈：第一圈可能只是清除了访问位
+  for(i = 0; got < n && !full && i < 2*NPROC; i++){
+    p = &proc[swap.hand];
+    va = swap.handva;
+    acquire(&p->lock);
+    if(p->state == SLEEPING){
+      for(; va < p->sz && got < n; va += PGSIZE){
+        if((pte = walk(p->pagetable, va, 0)) == 0)
+          continue;
+        if((*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U) || (*pte & PTE_COW))
+          continue;
+        if(*pte & PTE_A){
+          *pte &= ~PTE_A;
+          continue;
+        }
+        if(krefcnt((void*)PTE2PA(*pte)) != 1)
+          continue;
+        if((s = slotalloc()) < 0){
+          full = 1;
+          break;
+        }
+        pa[got] = PTE2PA(*pte);
+        slot[got] = s;
+        *pte = SLOT2PTE(s) | (PTE_FLAGS(*pte) & ~(PTE_V|PTE_A|PTE_D)) | PTE_SWAP;
+        got++;
+      }
+    } else {
+      va = p->sz;
+    }
+    release(&p->lock);
+
+    if(got < n){
+      swap.hand = (swap.hand + 1) % NPROC;
+      swap.handva = 0;
+    } else {
+      swap.handva = va;
+    }
+  }
+
+  for(i = 0; i < got; i++){
+    swaprw(slot[i], (char*)pa[i], 1);
+    kfree((void*)pa[i]);
+  }
+  releasesleep(&swap.iolock);
+  return got;
+}
+
+// 当前是否可以睡眠，即没有持有自旋锁。
+// 开着中断时进程可能换到别的 CPU 上，所以关中断后再读 noff，
+// 此时 push_off 自己占了一层。
+int
+cansleep(void)
+{
+  int n;
+
+  push_off();
+  n = mycpu()->noff;
+  pop_off();
+  return n == 1;
+}
+
+// 分配一页用户内存，内存不足时先换出一批页再试。
+// 持有自旋锁时不能睡眠，只能直接 kalloc。tag 见 memstat.h。
+void*
+swapalloc(int tag)
+{
+  void *pa;
+
+  while((pa = kalloc_tag(tag)) == 0){
+    if(!cansleep() || swapout(SWAPBATCH) == 0)
+      return 0;
+  }
+  return pa;
+}
+
+// 访问已换出的页时把它读回。
+// Returns 0 on success, -1 if va is not swapped out or out of memory.
+int
+swapfault(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  char *mem;
+  int slot;
+
+  if(va >= MAXVA)
+    return -1;
+  if((pte = walk(pagetable, va, 0)) == 0 || (*pte & (PTE_V|PTE_SWAP)) != PTE_SWAP)
+    return -1;
+  // swapalloc 可能睡眠，但已换出的 PTE 只有页表的所有者会修改
+  if((mem = swapalloc(KM_USER)) == 0)
+    return -1;
+  slot = PTE2SLOT(*pte);
+  acquiresleep(&swap.iolock);
+  swaprw(slot, mem, 0);
+  releasesleep(&swap.iolock);
+  *pte = PA2PTE(mem) | (PTE_FLAGS(*pte) & ~PTE_SWAP) | PTE_V;
+  swapfree(slot);
+  return 0;
+}
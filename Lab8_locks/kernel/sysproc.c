@@ -0,0 +1,100 @@
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "date.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "memstat.h"
+
+// 这里仅列出修改的函数
+
+// 扫描至多 n 个用户页并合并内容相同的页，返回合并的页数
+uint64
+sys_ksmscan(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+  return ksmscan(n);
+}
+
+uint64
+sys_shmget(void)
+{
+  int key, size;
+
+  if(argint(0, &key) < 0 || argint(1, &size) < 0)
+    return -1;
+  return shmget(key, size);
+}
+
+uint64
+sys_shmat(void)
+{
+  int id;
+
+  if(argint(0, &id) < 0)
+    return -1;
+  return shmat(id);
+}
+
+uint64
+sys_shmdt(void)
+{
+  uint64 addr;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  return shmdt(addr);
+}
+
+uint64
+sys_shmrm(void)
+{
+  int id;
+
+  if(argint(0, &id) < 0)
+    return -1;
+  return shmrm(id);
+}
+
+// 把各用途占用的页数拷贝到用户的 struct memstat
+uint64
+sys_memstat(void)
+{
+  uint64 addr;
+  struct memstat st;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  kmemstat(&st);
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+// 增长时只扩大 p->sz，物理页在第一次访问时由 lazyfault 分配；
+// 缩小时立即释放。
+uint64
+sys_sbrk(void)
+{
+  int addr;
+  int n;
+  struct proc *p = myproc();
+
+  if(argint(0, &n) < 0)
+    return -1;
+  addr = p->sz;
+  if(n < 0){
+    if(growproc(n) < 0)
+      return -1;
+  } else {
+    if(p->sz + n >= TRAPFRAME)
+      return -1;
+    p->sz += n;
+  }
+  return addr;
+}
@@ -0,0 +1,473 @@
+#include "param.h"
+#include "types.h"
+#include "memlayout.h"
+#include "elf.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "memstat.h"
+#include "spinlock.h"
+#include "proc.h"
+
+// 这里仅列出修改和新增的函数
+
+extern uint64 memtop; // kalloc.c
+
+// 一次缺页最多分配的相邻堆页数
+#define NFAULTAROUND 8
+
+// 拆除地址空间时攒够这么多页再交给 kfree_bulk
+#define NBULK 32
+
+struct pgbatch {
+  void *pa[NBULK];
+  int n;
+};
+
+static void
+batchfree(struct pgbatch *b, void *pa)
+{
+  b->pa[b->n++] = pa;
+  if(b->n == NBULK){
+    kfree_bulk(b->pa, b->n);
+    b->n = 0;
+  }
+}
+
+// Return the address of the PTE in page table pagetable
+// that corresponds to virtual address va.  If alloc!=0,
+// create any required page-table pages.
+// A leaf PTE found above level 0 (a kernel megapage) is
+// returned as is.
+//
+// The risc-v Sv39 scheme has three levels of page-table
+// pages. A page-table page contains 512 64-bit PTEs.
+// A 64-bit virtual address is split into five fields:
+//   39..63 -- must be zero.
+//   30..38 -- 9 bits of level-2 index.
+//   21..29 -- 9 bits of level-1 index.
+//   12..20 -- 9 bits of level-0 index.
+//    0..11 -- 12 bits of byte offset within the page.
+pte_t *
+walk(pagetable_t pagetable, uint64 va, int alloc)
+{
+  if(va >= MAXVA)
+    panic("walk");
+
+  for(int level = 2; level > 0; level--) {
+    pte_t *pte = &pagetable[PX(level, va)];
+    if(*pte & PTE_V) {
+      if(*pte & (PTE_R|PTE_W|PTE_X))
+        return pte;
+      pagetable = (pagetable_t)PTE2PA(*pte);
+    } else {
+      if(!alloc || (pagetable = (pde_t*)kalloc_tag(KM_PGTBL)) == 0)
+        return 0;
+      memset(pagetable, 0, PGSIZE);
+      *pte = PA2PTE(pagetable) | PTE_V;
+    }
+  }
+  return &pagetable[PX(0, va)];
+}
+
+// 直接映射 [va, va+sz)：2MB 对齐的部分用 level-1 叶子 PTE（大页），
+// 首尾不对齐的部分用 4KB 页。只在启动时调用。
+static void
+kvmmapmega(uint64 va, uint64 sz, int perm)
+{
+  uint64 a, mstart, mend;
+  pte_t *pte;
+  pagetable_t pt;
+
+  mstart = MEGAROUNDUP(va);
+  mend = MEGAROUNDDOWN(va + sz);
+  if(mstart >= mend){
+    kvmmap(va, va, sz, perm);
+    return;
+  }
+  if(va < mstart)
+    kvmmap(va, va, mstart - va, perm);
+  for(a = mstart; a < mend; a += MEGASIZE){
+    pte = &kernel_pagetable[PX(2, a)];
+    if((*pte & PTE_V) == 0){
+      if((pt = (pagetable_t)kalloc_tag(KM_PGTBL)) == 0)
+        panic("kvmmapmega");
+      memset(pt, 0, PGSIZE);
+      *pte = PA2PTE(pt) | PTE_V;
+    }
+    pte = &((pagetable_t)PTE2PA(*pte))[PX(1, a)];
+    if(*pte & PTE_V)
+      panic("kvmmapmega: remap");
+    *pte = PA2PTE(a) | perm | PTE_V;
+  }
+  if(mend < va + sz)
+    kvmmap(mend, mend, va + sz - mend, perm);
+}
+
+// translate a kernel virtual address to
+// a physical address. only needed for
+// addresses on the stack.
+// assumes va is page aligned.
+// handles leaves at any level, since RAM is
+// direct-mapped with megapages.
+uint64
+kvmpa(uint64 va)
+{
+  pagetable_t pagetable = kernel_pagetable;
+  pte_t *pte;
+
+  for(int level = 2; level >= 0; level--){
+    pte = &pagetable[PX(level, va)];
+    if((*pte & PTE_V) == 0)
+      panic("kvmpa");
+    if(*pte & (PTE_R|PTE_W|PTE_X))
+      return PTE2PA(*pte) + (va & ((1L << (PGSHIFT + 9*level)) - 1));
+    pagetable = (pagetable_t)PTE2PA(*pte);
+  }
+  panic("kvmpa");
+}
+
+/*
+ * create a direct-map page table for the kernel.
+ * RAM is mapped up to memtop, which kinit read from the device tree.
+ */
+void
+kvminit()
+{
+  kernel_pagetable = (pagetable_t) kalloc_tag(KM_PGTBL);
+  memset(kernel_pagetable, 0, PGSIZE);
+
+  // uart registers
+  kvmmap(UART0, UART0, PGSIZE, PTE_R | PTE_W);
+
+  // virtio mmio disk interface
+  kvmmap(VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
+
+  // CLINT
+  kvmmap(CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+
+  // PLIC
+  kvmmap(PLIC, PLIC, 0x400000, PTE_R | PTE_W);
+
+  // map kernel text executable and read-only.
+  kvmmap(KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
+
+  // map kernel data and the physical RAM we'll make use of,
+  // with 2MB megapages where alignment allows.
+  kvmmapmega((uint64)etext, memtop-(uint64)etext, PTE_R | PTE_W);
+
+  // map the trampoline for trap entry/exit to
+  // the highest point in virtual memory.
+  kvmmap(TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
+}
+
+// create an empty user page table.
+// returns 0 if out of memory.
+pagetable_t
+uvmcreate()
+{
+  pagetable_t pagetable;
+  pagetable = (pagetable_t) kalloc_tag(KM_PGTBL);
+  if(pagetable == 0)
+    return 0;
+  memset(pagetable, 0, PGSIZE);
+  return pagetable;
+}
+
+// Load the user initcode into address 0 of pagetable,
+// for the very first process.
+// sz must be less than a page.
+void
+uvminit(pagetable_t pagetable, uchar *src, uint sz)
+{
+  char *mem;
+
+  if(sz >= PGSIZE)
+    panic("inituvm: more than a page");
+  mem = kalloc_tag(KM_USER);
+  memset(mem, 0, PGSIZE);
+  mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U);
+  memmove(mem, src, sz);
+}
+
+// Look up a virtual address, return the physical address,
+// or 0 if not mapped.
+// Can only be used to look up user pages.
+// A heap page that sbrk reserved but nobody touched yet is
+// allocated here, and a swapped-out page is read back, since
+// the kernel may be the first to use it.
+uint64
+walkaddr(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  struct proc *p;
+
+  if(va >= MAXVA)
+    return 0;
+
+  pte = walk(pagetable, va, 0);
+  if(pte == 0 || (*pte & PTE_V) == 0){
+    p = myproc();
+    if(p == 0 || p->pagetable != pagetable)
+      return 0;
+    if(pte && (*pte & PTE_SWAP)){
+      // 读回需要睡眠，持有自旋锁时只能失败
+      if(!cansleep() || swapfault(pagetable, va) < 0)
+        return 0;
+    } else if(lazyfault(p, va) < 0){
+      return 0;
+    }
+    pte = walk(pagetable, va, 0);
+  }
+  if((*pte & PTE_U) == 0)
+    return 0;
+  pa = PTE2PA(*pte);
+  return pa;
+}
+
+// Remove npages of mappings starting from va. va must be
+// page-aligned. Pages that were never touched (lazy heap)
+// are skipped. Optionally free the physical memory, or the
+// swap slot of a page that was swapped out.
+// Freed pages go back to kalloc in batches.
+void
+uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
+{
+  uint64 a;
+  pte_t *pte;
+  struct pgbatch b;
+
+  if((va % PGSIZE) != 0)
+    panic("uvmunmap: not aligned");
+
+  b.n = 0;
+  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
+    if((pte = walk(pagetable, a, 0)) == 0)
+      continue;
+    if((*pte & PTE_V) == 0){
+      if(*pte & PTE_SWAP){
+        if(do_free)
+          swapfree(PTE2SLOT(*pte));
+        *pte = 0;
+      }
+      continue;
+    }
+    if(PTE_FLAGS(*pte) == PTE_V)
+      panic("uvmunmap: not a leaf");
+    if(do_free)
+      batchfree(&b, (void*)PTE2PA(*pte));
+    *pte = 0;
+  }
+  if(b.n > 0)
+    kfree_bulk(b.pa, b.n);
+}
+
+static void
+freewalk1(pagetable_t pagetable, struct pgbatch *b)
+{
+  // there are 2^9 = 512 PTEs in a page table.
+  for(int i = 0; i < 512; i++){
+    pte_t pte = pagetable[i];
+    if((pte & PTE_V) && (pte & (PTE_R|PTE_W|PTE_X)) == 0){
+      // this PTE points to a lower-level page table.
+      uint64 child = PTE2PA(pte);
+      freewalk1((pagetable_t)child, b);
+      pagetable[i] = 0;
+    } else if(pte & PTE_V){
+      panic("freewalk: leaf");
+    }
+  }
+  batchfree(b, (void*)pagetable);
+}
+
+// Recursively free page-table pages.
+// All leaf mappings must already have been removed.
+void
+freewalk(pagetable_t pagetable)
+{
+  struct pgbatch b;
+
+  b.n = 0;
+  freewalk1(pagetable, &b);
+  if(b.n > 0)
+    kfree_bulk(b.pa, b.n);
+}
+
+// Allocate PTEs and physical memory to grow process from oldsz to
+// newsz, which need not be page aligned.  Returns new size or 0 on error.
+// Under memory pressure other processes' pages are swapped out.
+uint64
+uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
+{
+  char *mem;
+  uint64 a;
+
+  if(newsz < oldsz)
+    return oldsz;
+
+  oldsz = PGROUNDUP(oldsz);
+  for(a = oldsz; a < newsz; a += PGSIZE){
+    mem = swapalloc(KM_USER);
+    if(mem == 0){
+      uvmdealloc(pagetable, a, oldsz);
+      return 0;
+    }
+    memset(mem, 0, PGSIZE);
+    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
+      kfree(mem);
+      uvmdealloc(pagetable, a, oldsz);
+      return 0;
+    }
+  }
+  return newsz;
+}
+
+// Given a parent process's page table, share its memory
+// with a child's page table copy-on-write: writable pages
+// lose PTE_W and gain PTE_COW in both, except shared memory
+// pages, and each physical page's reference count is incremented.
+// returns 0 on success, -1 on failure.
+// frees any allocated pages on failure.
+int
+uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
+{
+  pte_t *pte, *npte;
+  uint64 pa, i;
+  uint flags;
+
+  for(i = 0; i < sz; i += PGSIZE){
+    if((pte = walk(old, i, 0)) == 0)
+      continue;
+    if((*pte & PTE_V) == 0){
+      // 已换出的页由父子进程共享交换槽；尚未访问的堆页跳过
+      if(*pte & PTE_SWAP){
+        if((npte = walk(new, i, 1)) == 0)
+          goto err;
+        *npte = *pte;
+        swapdup(PTE2SLOT(*pte));
+      }
+      continue;
+    }
+    // 共享内存页保持可写，父子进程共享
+    if((*pte & PTE_W) && (*pte & PTE_SHM) == 0)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
+    pa = PTE2PA(*pte);
+    flags = PTE_FLAGS(*pte);
+    if(mappages(new, i, PGSIZE, pa, flags) != 0){
+      goto err;
+    }
+    krefinc((void*)pa);
+  }
+  return 0;
+
+ err:
+  uvmunmap(new, 0, i / PGSIZE, 1);
+  return -1;
+}
+
+// 处理对 COW 页的写。只剩当前页表引用时直接恢复写权限，
+// 否则复制一份新页并释放对原页的引用。
+// Returns 0 on success, -1 if va is not a COW page or out of memory.
+int
+cowfault(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  uint flags;
+  char *mem;
+
+  if(va >= MAXVA)
+    return -1;
+  if((pte = walk(pagetable, va, 0)) == 0)
+    return -1;
+  if((*pte & PTE_V) == 0 || (*pte & PTE_U) == 0 || (*pte & PTE_COW) == 0)
+    return -1;
+  pa = PTE2PA(*pte);
+  flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+  if(krefcnt((void*)pa) == 1){
+    *pte = PA2PTE(pa) | flags;
+    return 0;
+  }
+  if((mem = swapalloc(KM_USER)) == 0)
+    return -1;
+  memmove(mem, (char*)pa, PGSIZE);
+  *pte = PA2PTE(mem) | flags;
+  kfree((void*)pa);
+  return 0;
+}
+
+// 堆页第一次被访问时分配并清零。va 所在页之后连续的未映射页
+// 也一并分配，最多 NFAULTAROUND 页，摊薄陷入的开销。
+// 遇到已映射或已换出（PTE_SWAP）的页就停下，不能覆盖它们。
+// Returns 0 on success, -1 if va is not a lazy heap page or out of memory.
+int
+lazyfault(struct proc *p, uint64 va)
+{
+  void *pages[NFAULTAROUND];
+  uint64 a;
+  pte_t *pte;
+  int i, n, got;
+
+  // 栈顶以下是代码、数据、栈和保护页，不是堆
+  if(va >= p->sz || va < PGROUNDUP(p->trapframe->sp))
+    return -1;
+
+  a = PGROUNDDOWN(va);
+  for(n = 0; n < NFAULTAROUND && a + n*PGSIZE < p->sz; n++){
+    pte = walk(p->pagetable, a + n*PGSIZE, 0);
+    if(pte && (*pte & (PTE_V|PTE_SWAP)))
+      break;
+  }
+  if(n == 0)
+    return -1;
+
+  got = kallocn(pages, n, KM_USER);
+  if(got == 0 && (pages[0] = swapalloc(KM_USER)) != 0)
+    got = 1;
+  for(i = 0; i < got; i++){
+    memset(pages[i], 0, PGSIZE);
+    if(mappages(p->pagetable, a + i*PGSIZE, PGSIZE, (uint64)pages[i],
+                PTE_W|PTE_R|PTE_U) != 0)
+      break;
+  }
+  for(n = i; n < got; n++)
+    kfree(pages[n]);
+  return i > 0 ? 0 : -1;
+}
+
+// Copy from kernel to user.
+// Copy len bytes from src to virtual address dstva in a given page table.
+// Return 0 on success, -1 on error.
+int
+copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
+{
+  uint64 n, va0, pa0;
+  pte_t *pte;
+
+  while(len > 0){
+    va0 = PGROUNDDOWN(dstva);
+    pa0 = walkaddr(pagetable, va0);
+    if(pa0 == 0)
+      return -1;
+    // 内核写用户内存不经过 PTE_W 检查：COW 页要先复制，
+    // 只读页（可能与其他进程共享）不能写
+    pte = walk(pagetable, va0, 0);
+    if(*pte & PTE_COW){
+      if(cowfault(pagetable, va0) < 0)
+        return -1;
+      pa0 = PTE2PA(*pte);
+    }
+    if((*pte & PTE_W) == 0)
+      return -1;
+    n = PGSIZE - (dstva - va0);
+    if(n > len)
+      n = len;
+    memmove((void *)(pa0 + (dstva - va0)), src, n);
+
+    len -= n;
+    src += n;
+    dstva = va0 + n;
+  }
+  return 0;
+}
@@ -0,0 +1,52 @@
+// allocbench: make the kernel allocate and free pages as fast as it
+// can, by growing the heap, touching each new page and shrinking it
+// again, and report the time per batch of alloc/free pairs.
+// With several processes, each runs the loop on its own.
+// usage: allocbench [pages-per-round [rounds [processes]]]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+
+static void
+loop(int npages, int rounds)
+{
+  char *p;
+  int r, i;
+
+  for(r = 0; r < rounds; r++){
+    if((p = sbrk(npages * PGSIZE)) == (char*)-1){
+      printf("allocbench: sbrk failed\n");
+      exit(1);
+    }
+    for(i = 0; i < npages; i++)
+      p[i * PGSIZE] = i;
+    sbrk(-npages * PGSIZE);
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int npages = 256, rounds = 1000, nproc = 1, i, t0;
+
+  if(argc > 1)
+    npages = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(argc > 3)
+    nproc = atoi(argv[3]);
+
+  t0 = uptime();
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0)
+      loop(npages, rounds);
+  }
+  for(i = 0; i < nproc; i++)
+    wait(0);
+  printf("allocbench: %d processes x %d alloc/free pairs in %d ticks\n",
+         nproc, npages * rounds, uptime() - t0);
+  exit(0);
+}
@@ -0,0 +1,94 @@
+// copybench: time kernel work that sweeps physical memory through the
+// kernel's direct map: zero-filling freshly faulted heap pages,
+// copying through a pipe, and reading a file held in the buffer cache.
+// usage: copybench [megabytes]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define CHUNK  4096
+#define FILEKB 16    // 小于 bcache，读第二遍起全部命中
+
+static char buf[CHUNK];
+
+// 按需分配的堆页由 kalloc 取出并清零
+static void
+faults(int mb)
+{
+  char *p, *end;
+  int t0;
+
+  t0 = uptime();
+  if((p = sbrk(mb*1024*1024)) == (char*)-1){
+    printf("copybench: cannot grow by %d MB\n", mb);
+    exit(1);
+  }
+  for(end = p + mb*1024*1024; p < end; p += PGSIZE)
+    *p = 1;
+  sbrk(-mb*1024*1024);
+  printf("copybench: zero-fill %d MB %d ticks\n", mb, uptime() - t0);
+}
+
+// 每个字节经 copyin 进管道、再经 copyout 出管道
+static void
+viapipe(int mb)
+{
+  int fds[2], i, n, t0;
+
+  pipe(fds);
+  t0 = uptime();
+  if(fork() == 0){
+    close(fds[0]);
+    for(i = 0; i < mb * (1024*1024/CHUNK); i++)
+      write(fds[1], buf, CHUNK);
+    exit(0);
+  }
+  close(fds[1]);
+  while((n = read(fds[0], buf, CHUNK)) > 0)
+    ;
+  close(fds[0]);
+  wait(0);
+  printf("copybench: pipe %d MB %d ticks\n", mb, uptime() - t0);
+}
+
+static void
+viafile(int mb)
+{
+  int fd, i, n, t0;
+
+  if((fd = open("cbfile", O_CREATE|O_WRONLY|O_TRUNC)) < 0){
+    printf("copybench: cannot create cbfile\n");
+    exit(1);
+  }
+  for(i = 0; i < FILEKB * 1024 / CHUNK; i++)
+    write(fd, buf, CHUNK);
+  close(fd);
+
+  t0 = uptime();
+  for(i = 0; i < mb * 1024 / FILEKB; i++){
+    if((fd = open("cbfile", O_RDONLY)) < 0){
+      printf("copybench: cannot open cbfile\n");
+      exit(1);
+    }
+    while((n = read(fd, buf, CHUNK)) > 0)
+      ;
+    close(fd);
+  }
+  printf("copybench: cached file %d MB %d ticks\n", mb, uptime() - t0);
+  unlink("cbfile");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 64;
+
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  faults(mb);
+  viapipe(mb);
+  viafile(mb);
+  exit(0);
+}
@@ -0,0 +1,48 @@
+// exitbench: time how long the exit of a process with a large,
+// fully touched heap takes, from the moment it calls exit until
+// the parent's wait returns.
+// usage: exitbench [megabytes [iterations]]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 64, n = 10, i, fds[2], t, total = 0;
+  char *p, *end, c;
+
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  if(argc > 2)
+    n = atoi(argv[2]);
+
+  for(i = 0; i < n; i++){
+    pipe(fds);
+    if(fork() == 0){
+      close(fds[0]);
+      if((p = sbrk(mb*1024*1024)) == (char*)-1){
+        printf("exitbench: cannot grow by %d MB\n", mb);
+        exit(1);
+      }
+      for(end = p + mb*1024*1024; p < end; p += PGSIZE)
+        *p = 1;
+      // 通知父进程开始计时后立即退出
+      write(fds[1], "x", 1);
+      exit(0);
+    }
+    close(fds[1]);
+    if(read(fds[0], &c, 1) != 1){
+      printf("exitbench: child failed\n");
+      exit(1);
+    }
+    t = uptime();
+    wait(0);
+    total += uptime() - t;
+    close(fds[0]);
+  }
+  printf("exitbench: %d exits of %d MB processes in %d ticks\n", n, mb, total);
+  exit(0);
+}
@@ -0,0 +1,65 @@
+// forkbench: time fork and fork+exec from processes of 1MB, 16MB
+// and 64MB, with every heap page touched before forking.
+// usage: forkbench [iterations]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define NSIZE  3
+
+static int sizes[NSIZE] = { 1, 16, 64 };   // MB
+
+int
+main(int argc, char *argv[])
+{
+  char *argv2[] = { "forkbench", "-x", 0 };
+  char *p, *end;
+  int i, s, n = 100, pid, t0, tfork, texec;
+
+  // exec 出来的子进程直接退出
+  if(argc > 1 && strcmp(argv[1], "-x") == 0)
+    exit(0);
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  for(s = 0; s < NSIZE; s++){
+    end = sbrk(0);
+    if(sbrk(sizes[s]*1024*1024 - (int)(uint64)end) == (char*)-1){
+      printf("forkbench: cannot grow to %d MB\n", sizes[s]);
+      exit(1);
+    }
+    for(p = end; p < sbrk(0); p += PGSIZE)
+      *p = 1;
+
+    t0 = uptime();
+    for(i = 0; i < n; i++){
+      if((pid = fork()) < 0){
+        printf("forkbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0)
+        exit(0);
+      wait(0);
+    }
+    tfork = uptime() - t0;
+
+    t0 = uptime();
+    for(i = 0; i < n; i++){
+      if((pid = fork()) < 0){
+        printf("forkbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        exec(argv2[0], argv2);
+        exit(1);
+      }
+      wait(0);
+    }
+    texec = uptime() - t0;
+
+    printf("forkbench: %d MB: %d fork %d ticks, %d fork+exec %d ticks\n",
+           sizes[s], n, tfork, n, texec);
+  }
+  exit(0);
+}
@@ -0,0 +1,26 @@
+// ksmd: drive kernel same-page merging from user space.
+// usage: ksmd [pages-per-round [ticks-between-rounds]]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int npages = 256, interval = 10;
+  int n, total = 0;
+
+  if(argc > 1)
+    npages = atoi(argv[1]);
+  if(argc > 2)
+    interval = atoi(argv[2]);
+
+  for(;;){
+    n = ksmscan(npages);
+    if(n > 0){
+      total += n;
+      printf("ksmd: merged %d pages (%d total)\n", n, total);
+    }
+    sleep(interval);
+  }
+}
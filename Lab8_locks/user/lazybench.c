@@ -0,0 +1,66 @@
+// lazybench: reserve a large heap, touch a fraction of it, and report
+// how many pages that costs and how long it takes.
+// usage: lazybench [megabytes [percent-touched [iterations]]]
+
+#include "kernel/types.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+
+static int
+freepages(void)
+{
+  struct memstat st;
+
+  if(memstat(&st) < 0){
+    printf("lazybench: memstat failed\n");
+    exit(1);
+  }
+  return st.free;
+}
+
+// 在子进程中预留 mb MB、按顺序访问前 pct% 的页，然后退出
+static void
+start(int mb, int pct, int report)
+{
+  int f0, f1, f2, npages, i;
+  char *p;
+
+  npages = mb * (1024*1024/PGSIZE);
+  f0 = freepages();
+  if((p = sbrk(npages * PGSIZE)) == (char*)-1){
+    printf("lazybench: cannot reserve %d MB\n", mb);
+    exit(1);
+  }
+  f1 = freepages();
+  for(i = 0; i < npages * pct / 100; i++)
+    p[i * PGSIZE] = i;
+  f2 = freepages();
+  if(report)
+    printf("lazybench: %d pages reserved, %d used after sbrk, %d after touching %d\n",
+           npages, f0 - f1, f0 - f2, npages * pct / 100);
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 64, pct = 10, n = 20, i, t0;
+
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  if(argc > 2)
+    pct = atoi(argv[2]);
+  if(argc > 3)
+    n = atoi(argv[3]);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(fork() == 0)
+      start(mb, pct, i == 0);
+    wait(0);
+  }
+  printf("lazybench: %d starts in %d ticks\n", n, uptime() - t0);
+  exit(0);
+}
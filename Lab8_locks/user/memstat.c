@@ -0,0 +1,48 @@
+// memstat: print how many kernel pages each subsystem holds.
+// usage: memstat [interval]
+// With an interval (in ticks), keep printing until killed.
+
+#include "kernel/types.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+static char *names[KM_NTAG] = {
+[KM_OTHER]     "other",
+[KM_PGTBL]     "pagetable",
+[KM_USER]      "user",
+[KM_KSTACK]    "kstack",
+[KM_TRAPFRAME] "trapframe",
+[KM_PIPE]      "pipe",
+[KM_BCACHE]    "bcache",
+[KM_SHM]       "shm",
+};
+
+static void
+show(void)
+{
+  struct memstat st;
+  int t;
+
+  if(memstat(&st) < 0){
+    fprintf(2, "memstat: failed\n");
+    exit(1);
+  }
+  printf("total %d free %d\n", (int)st.total, (int)st.free);
+  for(t = 0; t < KM_NTAG; t++)
+    printf("  %s %d\n", names[t], (int)st.pages[t]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int interval = 0;
+
+  if(argc > 1)
+    interval = atoi(argv[1]);
+  show();
+  while(interval > 0){
+    sleep(interval);
+    show();
+  }
+  exit(0);
+}
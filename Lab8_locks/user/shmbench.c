@@ -0,0 +1,134 @@
+// shmbench: move data from a producer to a consumer process through
+// a shared memory segment and through a pipe, and report the time
+// each takes.  The shared segment holds two chunks that are used in
+// turn; one-byte messages on pipes say when a chunk is full or free.
+// usage: shmbench [megabytes]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define CHUNK  (32*1024)
+#define SHMKEY 0x5b
+
+static uint buf[CHUNK/sizeof(uint)];
+
+static void
+fill(uint *p, int k)
+{
+  int i;
+
+  for(i = 0; i < CHUNK/sizeof(uint); i++)
+    p[i] = k + i;
+}
+
+static uint
+sum(uint *p)
+{
+  uint s = 0;
+  int i;
+
+  for(i = 0; i < CHUNK/sizeof(uint); i++)
+    s += p[i];
+  return s;
+}
+
+static void
+report(char *label, int t0, uint s)
+{
+  printf("shmbench: %s %d ticks, checksum %x\n", label, uptime() - t0, s);
+}
+
+static void
+viashm(int nchunk)
+{
+  int full[2], empty[2], id, k, t0;
+  uint *seg, s = 0;
+  char c = 0;
+
+  if((id = shmget(SHMKEY, 2*CHUNK)) < 0){
+    printf("shmbench: shmget failed\n");
+    exit(1);
+  }
+  pipe(full);
+  pipe(empty);
+  t0 = uptime();
+  if(fork() == 0){
+    close(full[1]);
+    close(empty[0]);
+    if((seg = (uint*)shmat(id)) == (uint*)-1){
+      printf("shmbench: shmat failed\n");
+      exit(1);
+    }
+    for(k = 0; k < nchunk; k++){
+      if(read(full[0], &c, 1) != 1)
+        exit(1);
+      s += sum(seg + (k % 2) * (CHUNK/sizeof(uint)));
+      write(empty[1], &c, 1);
+    }
+    report("shm ", t0, s);
+    exit(0);
+  }
+
+  close(full[0]);
+  close(empty[1]);
+  if((seg = (uint*)shmat(id)) == (uint*)-1){
+    printf("shmbench: shmat failed\n");
+    exit(1);
+  }
+  for(k = 0; k < nchunk; k++){
+    // 两块轮流使用，写第 k 块前要等消费者读完第 k-2 块
+    if(k >= 2 && read(empty[0], &c, 1) != 1)
+      break;
+    fill(seg + (k % 2) * (CHUNK/sizeof(uint)), k);
+    write(full[1], &c, 1);
+  }
+  wait(0);
+  shmdt((char*)seg);
+  shmrm(id);
+  close(full[1]);
+  close(empty[0]);
+}
+
+static void
+viapipe(int nchunk)
+{
+  int fds[2], k, n, m, t0;
+  uint s = 0;
+
+  pipe(fds);
+  t0 = uptime();
+  if(fork() == 0){
+    close(fds[1]);
+    for(k = 0; k < nchunk; k++){
+      for(n = 0; n < CHUNK; n += m){
+        if((m = read(fds[0], (char*)buf + n, CHUNK - n)) <= 0)
+          exit(1);
+      }
+      s += sum(buf);
+    }
+    report("pipe", t0, s);
+    exit(0);
+  }
+
+  close(fds[0]);
+  for(k = 0; k < nchunk; k++){
+    fill(buf, k);
+    if(write(fds[1], buf, CHUNK) != CHUNK)
+      break;
+  }
+  close(fds[1]);
+  wait(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 256;
+
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  printf("shmbench: %d MB in %d KB chunks\n", mb, CHUNK/1024);
+  viashm(mb * (1024*1024/CHUNK));
+  viapipe(mb * (1024*1024/CHUNK));
+  exit(0);
+}
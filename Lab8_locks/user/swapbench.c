@@ -0,0 +1,84 @@
+// swapbench: run several workers whose heaps together exceed free
+// memory, letting them take turns to touch and check every page of
+// their heap, and report how long the rounds take.  Workers wait for
+// their turn in read(), so the pages of the others can be swapped out.
+// usage: swapbench [extra-pages [workers [rounds]]]
+
+#include "kernel/types.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define MAXW   8
+
+static int fds[MAXW][2];
+
+// 出错时仍然传递令牌，避免其他 worker 一直等待
+static void
+worker(int id, int nw, int npages, int rounds)
+{
+  char *p = 0, tok;
+  int r, i, bad = 0;
+
+  for(r = 0; r < rounds; r++){
+    if(read(fds[id][0], &tok, 1) != 1)
+      exit(1);
+    if(r == 0 && (p = sbrk(npages * PGSIZE)) == (char*)-1){
+      printf("swapbench: worker %d cannot grow\n", id);
+      npages = 0;
+      bad = 1;
+    }
+    for(i = 0; i < npages; i++){
+      if(r > 0 && p[i*PGSIZE] != (char)(id + i) && !bad){
+        printf("swapbench: worker %d page %d corrupted\n", id, i);
+        bad = 1;
+      }
+      p[i*PGSIZE] = id + i;
+    }
+    write(fds[(id + 1) % nw][1], &tok, 1);
+  }
+  exit(bad);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct memstat st;
+  int extra = 1024, nw = 4, rounds = 4, npages, i, t0, xstatus, bad = 0;
+
+  if(argc > 1)
+    extra = atoi(argv[1]);
+  if(argc > 2)
+    nw = atoi(argv[2]);
+  if(argc > 3)
+    rounds = atoi(argv[3]);
+  if(nw < 2 || nw > MAXW){
+    printf("swapbench: 2 to %d workers\n", MAXW);
+    exit(1);
+  }
+  if(memstat(&st) < 0){
+    printf("swapbench: memstat failed\n");
+    exit(1);
+  }
+  npages = (st.free + extra) / nw;
+  printf("swapbench: %d free pages, %d workers of %d pages, %d rounds\n",
+         (int)st.free, nw, npages, rounds);
+
+  for(i = 0; i < nw; i++)
+    pipe(fds[i]);
+  for(i = 0; i < nw; i++){
+    if(fork() == 0)
+      worker(i, nw, npages, rounds);
+  }
+
+  t0 = uptime();
+  write(fds[0][1], "x", 1);
+  for(i = 0; i < nw; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      bad = 1;
+  }
+  printf("swapbench: %d rounds in %d ticks%s\n", rounds, uptime() - t0,
+         bad ? ", some workers failed" : "");
+  exit(bad);
+}
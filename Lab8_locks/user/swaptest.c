@@ -0,0 +1,66 @@
+// swaptest: 检查按需分配堆页时不会覆盖已换出的相邻页。
+// 父进程写好堆上的高地址页，子进程占满内存把它换出，
+// 父进程再访问它下面未分配的页，lazyfault 向后预分配时必须跳过它。
+
+#include "kernel/types.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define NEXTRA 256   // 超出空闲页数再占用的页数，迫使其他进程的页被换出
+
+// 占用比空闲内存多 NEXTRA 页的内存，然后退出
+static void
+hog(void)
+{
+  struct memstat st;
+  char *p;
+  int i, n;
+
+  if(memstat(&st) < 0){
+    printf("swaptest: memstat failed\n");
+    exit(1);
+  }
+  n = st.free + NEXTRA;
+  for(i = 0; i < n; i++){
+    if((p = sbrk(PGSIZE)) == (char*)-1)
+      break;
+    p[0] = i;
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *base, *hi;
+  int i, pid;
+
+  base = sbrk(2*PGSIZE);
+  if(base == (char*)-1){
+    printf("swaptest: sbrk failed\n");
+    exit(1);
+  }
+  hi = base + PGSIZE;
+  for(i = 0; i < PGSIZE; i++)
+    hi[i] = i % 251;
+
+  if((pid = fork()) < 0){
+    printf("swaptest: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0)
+    hog();
+  wait(0);
+
+  // 低地址页从未访问过，这里由 lazyfault 分配
+  base[0] = 1;
+  for(i = 0; i < PGSIZE; i++){
+    if(hi[i] != (char)(i % 251)){
+      printf("swaptest: FAILED, byte %d of the swapped page is %d\n", i, hi[i]);
+      exit(1);
+    }
+  }
+  printf("swaptest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,268 @@
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "buf.h"
+
+// 这里仅列出修改和新增的部分，其余与原版 bio.c 相同
+
+// 块设备开关：按 dev 找到驱动的读写函数，ROOTDEV 是 virtio 磁盘。
+static void (*bdevsw[NBDEV])(struct buf*, int);
+
+void
+bdevregister(uint dev, void (*rw)(struct buf*, int))
+{
+  if(dev >= NBDEV)
+    panic("bdevregister");
+  bdevsw[dev] = rw;
+}
+
+// dev 上有没有驱动
+int
+bdevok(uint dev)
+{
+  return dev == ROOTDEV || (dev < NBDEV && bdevsw[dev] != 0);
+}
+
+static void
+bdevrw(struct buf *b, int write)
+{
+  if(b->dev < NBDEV && bdevsw[b->dev])
+    bdevsw[b->dev](b, write);
+  else if(b->dev == ROOTDEV)
+    virtio_disk_rw(b, write);
+  else
+    panic("bdevrw: no driver");
+}
+
+// O_DIRECT 使用的缓冲区。它们不在 bcache 的 LRU 链表上，
+// 因此大文件的流式读写不会把 bcache 中的热块挤出去。
+#define NDBUF 4
+
+static struct {
+  struct spinlock lock;
+  struct buf buf[NDBUF];
+} dcache;
+
+void
+binit(void)
+{
+  struct buf *b;
+
+  initlock(&bcache.lock, "bcache");
+
+  // Create linked list of buffers
+  bcache.head.prev = &bcache.head;
+  bcache.head.next = &bcache.head;
+  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
+    b->next = bcache.head.next;
+    b->prev = &bcache.head;
+    initsleeplock(&b->lock, "buffer");
+    bcache.head.next->prev = b;
+    bcache.head.next = b;
+  }
+
+  initlock(&dcache.lock, "dcache");
+  for(b = dcache.buf; b < dcache.buf+NDBUF; b++)
+    initsleeplock(&b->lock, "buffer");
+}
+
+// Return a locked buf with the contents of the indicated block.
+struct buf*
+bread(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  if(!b->valid) {
+    bdevrw(b, 0);
+    b->valid = 1;
+  }
+  return b;
+}
+
+// Write b's contents to disk.  Must be locked.
+void
+bwrite(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("bwrite");
+  bdevrw(b, 1);
+}
+
+static int
+isdirect(struct buf *b)
+{
+  return b >= dcache.buf && b < dcache.buf+NDBUF;
+}
+
+// 若块已在 bcache 中，增加其引用计数并返回（未加睡眠锁）；否则返回 0。
+// 不会分配或复用任何缓冲区。
+static struct buf*
+bcached(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  acquire(&bcache.lock);
+  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+    if(b->dev == dev && b->blockno == blockno){
+      b->refcnt++;
+      release(&bcache.lock);
+      return b;
+    }
+  }
+  release(&bcache.lock);
+  return 0;
+}
+
+// Return a locked buf for direct I/O on the indicated block,
+// without reading it.  If the block is cached, the cached copy
+// is returned so that direct and cached accesses stay coherent;
+// otherwise a private direct buffer is used and bcache is untouched.
+struct buf*
+bget_direct(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  if((b = bcached(dev, blockno)) != 0){
+    acquiresleep(&b->lock);
+    return b;
+  }
+
+  acquire(&dcache.lock);
+  for(;;){
+    for(b = dcache.buf; b < dcache.buf+NDBUF; b++){
+      if(b->refcnt == 0){
+        b->dev = dev;
+        b->blockno = blockno;
+        b->valid = 0;
+        b->refcnt = 1;
+        release(&dcache.lock);
+        acquiresleep(&b->lock);
+        return b;
+      }
+    }
+    // direct 缓冲区都在使用中，等待 brelse 归还
+    sleep(&dcache, &dcache.lock);
+  }
+}
+
+// Like bread, but a block that is not already cached is read
+// into a direct buffer instead of evicting a cached one.
+struct buf*
+bread_direct(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget_direct(dev, blockno);
+  if(!b->valid){
+    bdevrw(b, 0);
+    b->valid = 1;
+  }
+  return b;
+}
+
+// Write a buffer obtained from bget_direct/bread_direct.
+// A cached block goes through the log like any other write;
+// a direct buffer is written in place.  Caller is inside a
+// transaction and only uses this for file data blocks, so the
+// in-place write is ordered before the commit of the metadata
+// (block pointers, size) that refers to it.
+void
+bwrite_direct(struct buf *b)
+{
+  if(isdirect(b))
+    bwrite(b);
+  else
+    log_write(b);
+}
+
+// Release a locked buffer.
+// Move to the head of the most-recently-used list, or to the
+// tail if the caller does not expect to use the block again.
+static void
+brelse1(struct buf *b, int cold)
+{
+  if(!holdingsleep(&b->lock))
+    panic("brelse");
+
+  releasesleep(&b->lock);
+
+  if(isdirect(b)){
+    acquire(&dcache.lock);
+    b->refcnt--;
+    wakeup(&dcache);
+    release(&dcache.lock);
+    return;
+  }
+
+  acquire(&bcache.lock);
+  b->refcnt--;
+  if (b->refcnt == 0) {
+    // no one is waiting for it.
+    b->next->prev = b->prev;
+    b->prev->next = b->next;
+    if(cold){
+      // 用过即弃的块放到表尾，成为下一个被复用的块
+      b->prev = bcache.head.prev;
+      b->next = &bcache.head;
+      bcache.head.prev->next = b;
+      bcache.head.prev = b;
+    } else {
+      b->next = bcache.head.next;
+      b->prev = &bcache.head;
+      bcache.head.next->prev = b;
+      bcache.head.next = b;
+    }
+  }
+
+  release(&bcache.lock);
+}
+
+void
+brelse(struct buf *b)
+{
+  brelse1(b, 0);
+}
+
+// 顺序扫描（FADV_SEQUENTIAL）读完的块用这个释放，避免扫描冲掉热块。
+void
+brelse_cold(struct buf *b)
+{
+  brelse1(b, 1);
+}
+
+// 把一个块读入 bcache 但不持有它，供预读使用。
+void
+bprefetch(uint dev, uint blockno)
+{
+  brelse(bread(dev, blockno));
+}
+
+// 丢弃一个缓存块（FADV_DONTNEED）。只处理 refcnt == 0 的块：
+// 被日志 pin 住或正在使用的块不动，因此被丢弃的块一定是干净的。
+void
+bdrop(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  acquire(&bcache.lock);
+  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+    if(b->dev == dev && b->blockno == blockno){
+      if(b->refcnt == 0){
+        b->valid = 0;
+        b->next->prev = b->prev;
+        b->prev->next = b->next;
+        b->prev = bcache.head.prev;
+        b->next = &bcache.head;
+        bcache.head.prev->next = b;
+        bcache.head.prev = b;
+      }
+      break;
+    }
+  }
+  release(&bcache.lock);
+}
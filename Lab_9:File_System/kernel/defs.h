@@ -0,0 +1,61 @@
+// 这里仅列出新增的声明，其余与原版 defs.h 相同
+
+// bio.c
+struct buf*     bget_direct(uint, uint);
+struct buf*     bread_direct(uint, uint);
+void            bwrite_direct(struct buf*);
+void            brelse_cold(struct buf*);
+void            bprefetch(uint, uint);
+void            bdrop(uint, uint);
+void            bdevregister(uint, void (*)(struct buf*, int));
+int             bdevok(uint);
+
+// file.c
+int             fdalloc(struct file*);
+struct file*    fdget(int);
+void            fdfree(int);
+int             fdcopy(struct proc*, struct proc*);
+void            fdcloseall(struct proc*);
+
+// fs.c
+void            fsinit(int, int);
+int             fsrdonly(uint);
+int             fsmountdev(uint, char*, int);
+int             fsumount(char*);
+int             readi_direct(struct inode*, int, uint64, uint, uint);
+int             writei_direct(struct inode*, int, uint64, uint, uint);
+int             ifadvise(struct inode*, uint, uint, int);
+int             ireflink(struct inode*, struct inode*);
+int             dirunlink(struct inode*, uint);
+int             dirlist(struct inode*, uint*, char*, int, int);
+struct inode*   nameiat(struct inode*, char*);
+struct inode*   nameiparentat(struct inode*, char*, char*);
+int             stati_nolock(struct inode*, struct stat*);
+
+// log.c
+void            loginit(void);
+void            initlog(int, struct superblock*, int);
+void            freelog(int);
+void            log_freeze(void);
+void            log_thaw(void);
+
+// ramdisk.c
+void            ramdiskinit(void);
+int             ramdiskalloc(void);
+
+// tmpfs.c
+void            tmpfsinit(void);
+int             tmpfs_mount(void);
+void            tmpfs_unmount(void);
+uint            tmpfs_ialloc(short);
+void            tmpfs_load(struct inode*);
+void            tmpfs_store(struct inode*);
+void            tmpfs_trunc(struct inode*);
+char*           tmpfs_block(struct inode*, uint, int);
+void            tmpfs_stat(uint, uchar*, uint*);
+int             tmpfs_readi(struct inode*, int, uint64, uint, uint);
+int             tmpfs_writei(struct inode*, int, uint64, uint, uint);
+
+// lz.c
+int             lz_compress(const uchar*, int, uchar*, int);
+int             lz_decompress(const uchar*, int, uchar*, int);
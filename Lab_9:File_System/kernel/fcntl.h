@@ -0,0 +1,21 @@
+#define O_RDONLY  0x000
+#define O_WRONLY  0x001
+#define O_RDWR    0x002
+#define O_CREATE  0x200
+#define O_TRUNC   0x400
+#define O_NOFOLLOW 0x800
+#define O_DIRECT  0x1000  // 绕过 buffer cache 读写文件数据
+#define O_COMPRESS 0x2000 // 新建的空文件启用透明压缩
+
+#define AT_FDCWD  -100    // *at 系统调用中表示当前目录
+
+// 挂载标志
+#define MNT_RDONLY 0x1    // 只读挂载，不使用日志
+#define MNT_FORMAT 0x2    // 挂载前在内存盘上建立空文件系统
+
+// fadvise 的访问模式提示
+#define FADV_NORMAL     0
+#define FADV_RANDOM     1  // 关闭预读
+#define FADV_SEQUENTIAL 2  // 积极预读，读过的块尽快淘汰
+#define FADV_WILLNEED   3  // 预取指定范围
+#define FADV_DONTNEED   4  // 丢弃指定范围的干净缓存块
@@ -0,0 +1,321 @@
+//
+// Support functions for system calls that involve file descriptors.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "fs.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "stat.h"
+#include "proc.h"
+
+// 这里仅列出修改和新增的函数
+
+// struct file 不再来自固定的 NFILE 数组：空闲的对象串在 free 链上，
+// 链空时 kalloc 一页切成 FPP 个。页不归还，
+// 对象数随同时打开的文件数的峰值增长。
+#define FPP (PGSIZE / sizeof(struct file))
+
+struct {
+  struct spinlock lock;
+  struct file *free;
+} ftable;
+
+void
+fileinit(void)
+{
+  initlock(&ftable.lock, "ftable");
+}
+
+// Allocate a file structure.
+struct file*
+filealloc(void)
+{
+  struct file *f;
+  char *page;
+  int i;
+
+  acquire(&ftable.lock);
+  while((f = ftable.free) == 0){
+    release(&ftable.lock);
+    if((page = kalloc()) == 0)
+      return 0;
+    memset(page, 0, PGSIZE);
+    acquire(&ftable.lock);
+    for(i = 0; i < FPP; i++){
+      f = (struct file*)page + i;
+      f->next = ftable.free;
+      ftable.free = f;
+    }
+  }
+  ftable.free = f->next;
+  f->next = 0;
+  f->ref = 1;
+  release(&ftable.lock);
+  return f;
+}
+
+// Close file f.  (Decrement ref count, close when reaches 0.)
+void
+fileclose(struct file *f)
+{
+  struct file ff;
+
+  acquire(&ftable.lock);
+  if(f->ref < 1)
+    panic("fileclose");
+  if(--f->ref > 0){
+    release(&ftable.lock);
+    return;
+  }
+  ff = *f;
+  f->ref = 0;
+  f->type = FD_NONE;
+  f->next = ftable.free;
+  ftable.free = f;
+  release(&ftable.lock);
+
+  if(ff.type == FD_PIPE){
+    pipeclose(ff.pipe, ff.writable);
+  } else if(ff.type == FD_INODE || ff.type == FD_DEVICE){
+    begin_op();
+    iput(ff.ip);
+    end_op();
+  }
+}
+
+// 文件描述符 fd 在 p->fdchunk[fd / FDCHUNK] 中。二级表的位图记录哪些项在用，
+// p->fdfull 记录哪些二级表已满，找最小的空闲描述符只需在两层位图中
+// 各找一次最低的 0 位。描述符表只由进程自己访问，不用加锁。
+
+// 最低的 0 位
+static int
+ffz(uint64 x)
+{
+  return __builtin_ctzl(~x);
+}
+
+// Allocate a file descriptor for the given file.
+// Takes over file reference from caller on success.
+int
+fdalloc(struct file *f)
+{
+  struct proc *p = myproc();
+  struct fdchunk *c;
+  int i, w, b, fd;
+
+  if(p->fdfull == ~0UL || (i = ffz(p->fdfull)) >= NFDCHUNK)
+    return -1;
+  if((c = p->fdchunk[i]) == 0){
+    if((c = kalloc()) == 0)
+      return -1;
+    memset(c, 0, PGSIZE);
+    c->used[FDWORDS-1] = ~0UL << (FDCHUNK - (FDWORDS-1) * 64);
+    p->fdchunk[i] = c;
+  }
+
+  // 二级表未满，一定有某个字不全为 1
+  for(w = 0; c->used[w] == ~0UL; w++)
+    ;
+  b = ffz(c->used[w]);
+  c->used[w] |= 1UL << b;
+  c->f[w*64 + b] = f;
+  fd = i*FDCHUNK + w*64 + b;
+
+  for(w = 0; w < FDWORDS && c->used[w] == ~0UL; w++)
+    ;
+  if(w == FDWORDS)
+    p->fdfull |= 1UL << i;
+  return fd;
+}
+
+// 当前进程的描述符 fd 对应的文件，没有时返回 0
+struct file*
+fdget(int fd)
+{
+  struct fdchunk *c;
+
+  if(fd < 0 || fd >= NFDCHUNK*FDCHUNK || (c = myproc()->fdchunk[fd / FDCHUNK]) == 0)
+    return 0;
+  return c->f[fd % FDCHUNK];
+}
+
+// 释放描述符 fd，不关闭文件
+void
+fdfree(int fd)
+{
+  struct proc *p = myproc();
+  struct fdchunk *c = p->fdchunk[fd / FDCHUNK];
+  int i = fd % FDCHUNK;
+
+  c->f[i] = 0;
+  c->used[i / 64] &= ~(1UL << (i % 64));
+  p->fdfull &= ~(1UL << (fd / FDCHUNK));
+}
+
+// fork 时复制描述符表，子进程的每个描述符增加一个引用。
+// 先分配好全部二级表，分配失败时子进程还没有引用任何文件。
+int
+fdcopy(struct proc *np, struct proc *p)
+{
+  int i, j;
+
+  for(i = 0; i < NFDCHUNK; i++){
+    if(p->fdchunk[i] && (np->fdchunk[i] = kalloc()) == 0){
+      while(--i >= 0){
+        if(np->fdchunk[i]){
+          kfree(np->fdchunk[i]);
+          np->fdchunk[i] = 0;
+        }
+      }
+      return -1;
+    }
+  }
+
+  for(i = 0; i < NFDCHUNK; i++){
+    if(p->fdchunk[i] == 0)
+      continue;
+    memmove(np->fdchunk[i], p->fdchunk[i], PGSIZE);
+    for(j = 0; j < FDCHUNK; j++){
+      if(np->fdchunk[i]->f[j])
+        filedup(np->fdchunk[i]->f[j]);
+    }
+  }
+  np->fdfull = p->fdfull;
+  return 0;
+}
+
+// exit 时关闭所有文件并释放描述符表
+void
+fdcloseall(struct proc *p)
+{
+  int i, j;
+
+  for(i = 0; i < NFDCHUNK; i++){
+    if(p->fdchunk[i] == 0)
+      continue;
+    for(j = 0; j < FDCHUNK; j++){
+      if(p->fdchunk[i]->f[j])
+        fileclose(p->fdchunk[i]->f[j]);
+    }
+    kfree(p->fdchunk[i]);
+    p->fdchunk[i] = 0;
+  }
+  p->fdfull = 0;
+}
+
+// Get metadata about file f.
+// addr is a user virtual address, pointing to a struct stat.
+// 先无锁读取 inode 的 stat 快照，不与读写者争用睡眠锁。
+int
+filestat(struct file *f, uint64 addr)
+{
+  struct proc *p = myproc();
+  struct stat st;
+  
+  if(f->type == FD_INODE || f->type == FD_DEVICE){
+    if(stati_nolock(f->ip, &st) < 0){
+      ilock(f->ip);
+      stati(f->ip, &st);
+      iunlock(f->ip);
+    }
+    if(copyout(p->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+      return -1;
+    return 0;
+  }
+  return -1;
+}
+
+// Read from file f.
+// addr is a user virtual address.
+int
+fileread(struct file *f, uint64 addr, int n)
+{
+  int r = 0;
+
+  if(f->readable == 0)
+    return -1;
+
+  if(f->type == FD_PIPE){
+    r = piperead(f->pipe, addr, n);
+  } else if(f->type == FD_DEVICE){
+    if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
+      return -1;
+    r = devsw[f->major].read(1, addr, n);
+  } else if(f->type == FD_INODE){
+    ilock(f->ip);
+    if(f->direct)
+      r = readi_direct(f->ip, 1, addr, f->off, n);
+    else
+      r = readi(f->ip, 1, addr, f->off, n);
+    if(r > 0)
+      f->off += r;
+    iunlock(f->ip);
+  } else {
+    panic("fileread");
+  }
+
+  return r;
+}
+
+// Write to file f.
+// addr is a user virtual address.
+int
+filewrite(struct file *f, uint64 addr, int n)
+{
+  int r = 0, ret = 0;
+
+  if(f->writable == 0)
+    return -1;
+
+  if(f->type == FD_PIPE){
+    ret = pipewrite(f->pipe, addr, n);
+  } else if(f->type == FD_DEVICE){
+    if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
+      return -1;
+    ret = devsw[f->major].write(1, addr, n);
+  } else if(f->type == FD_INODE){
+    // write a few blocks at a time to avoid exceeding
+    // the maximum log transaction size, including
+    // i-node, indirect block, allocation blocks,
+    // and 2 blocks of slop for non-aligned writes.
+    // this really belongs lower down, since writei()
+    // might be writing a device like the console.
+    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+    int i = 0;
+    while(i < n){
+      int n1 = n - i;
+      if(n1 > max)
+        n1 = max;
+      // 压缩文件每次要重写整簇，一个事务只写一簇
+      if((f->ip->flags & DI_COMPRESS) && n1 > ZCLUSTER*BSIZE - f->off % (ZCLUSTER*BSIZE))
+        n1 = ZCLUSTER*BSIZE - f->off % (ZCLUSTER*BSIZE);
+
+      begin_op();
+      ilock(f->ip);
+      if(f->direct)
+        r = writei_direct(f->ip, 1, addr + i, f->off, n1);
+      else
+        r = writei(f->ip, 1, addr + i, f->off, n1);
+      if (r > 0)
+        f->off += r;
+      iunlock(f->ip);
+      end_op();
+
+      if(r != n1){
+        // error from writei
+        break;
+      }
+      i += r;
+    }
+    ret = (i == n ? n : -1);
+  } else {
+    panic("filewrite");
+  }
+
+  return ret;
+}
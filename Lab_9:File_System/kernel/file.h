@@ -3,10 +3,23 @@ struct file {
   int ref; // reference count
   char readable;
   char writable;
+  char direct;       // O_DIRECT：数据不经过 buffer cache
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
   uint off;          // FD_INODE
   short major;       // FD_DEVICE
+  struct file *next; // ftable 的空闲链
+};
+
+// 进程的文件描述符表分成若干页大小的二级表，按需分配。
+// used 是位图，FDCHUNK 之后的位恒为 1。
+// 有的文件在 riscv.h 之前包含 file.h，所以不用 PGSIZE 计算。
+#define FDWORDS  8
+#define FDCHUNK  504  // (4096 - FDWORDS*8) / 8，一个二级表正好一页
+
+struct fdchunk {
+  uint64 used[FDWORDS];
+  struct file *f[FDCHUNK];
 };
 
 #define major(dev)  ((dev) >> 16 & 0xFFFF)
@@ -18,6 +31,16 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+
+  // 供 stat 无锁读取的元数据快照，由持有 lock 的 iupdate/ilock 发布。
+  // seq 为奇数表示正在更新。
+  uint seq;
+  short stype;
+  short snlink;
+  uint ssize;
+
+  char mounted;       // 是挂载点，由 fs.c 的 mtab.lock 保护
+
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -25,8 +48,12 @@ struct inode {
   short major;
   short minor;
   short nlink;
+  ushort flags;       // DI_* flags
   uint size;
   uint addrs[NDIRECT+1+1]; // 在此修改
+
+  short advice;       // fadvise 提示（FADV_*），不写回磁盘
+  uint ranext;        // 下一个需要预读的逻辑块号
 };
 
 // map major device number to device functions.
@@ -20,8 +20,288 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "fcntl.h"
+
+// 这里仅列出修改和新增的函数
+
+// 挂载表，取代原来全局唯一的 sb。每个挂载的文件系统有自己的
+// 超级块和日志（log.c），根文件系统总在 mtab.m[0]。
+// 表项在挂载期间不变，fsmount 不加锁查找；
+// 增删表项时先冻结日志，再持有 mtab.lock 修改。
+struct mount {
+  uint dev;             // 0 表示空闲
+  int flags;            // MNT_*
+  struct superblock sb;
+  struct inode *mntpt;  // 挂载点，根文件系统为 0
+  struct inode *root;   // 被挂载文件系统的根目录
+};
+
+struct {
+  struct spinlock lock;
+  struct mount m[NMOUNT];
+} mtab;
+
+// dev 上挂载的文件系统
+static struct mount*
+fsmount(uint dev)
+{
+  struct mount *m;
+
+  for(m = mtab.m; m < mtab.m + NMOUNT; m++){
+    if(m->dev == dev)
+      return m;
+  }
+  panic("fsmount");
+}
+
+// Init fs
+// 挂载根文件系统。flags 含 MNT_RDONLY 时只读挂载：不使用日志，
+// bmap 只查找不分配，所有修改文件系统的系统调用都失败。
+void
+fsinit(int dev, int flags) {
+  struct mount *m = &mtab.m[0];
+
+  initlock(&mtab.lock, "mtab");
+  loginit();
+  ramdiskinit();
+  tmpfsinit();
+  readsb(dev, &m->sb);
+  if(m->sb.magic != FSMAGIC)
+    panic("invalid file system");
+  m->flags = flags;
+  initlog(dev, &m->sb, flags & MNT_RDONLY);
+  m->dev = dev;
+}
+
+// dev 上的文件系统是否只读挂载
+int
+fsrdonly(uint dev)
+{
+  return (fsmount(dev)->flags & MNT_RDONLY) != 0;
+}
+
+// Allocate a disk block, zeroed through the log if zero is set.
+// O_DIRECT 写入新块时自己写出整块内容，不需要先清零。
+static uint
+balloc1(uint dev, int zero)
+{
+  int b, bi, m;
+  struct buf *bp;
+  struct mount *mp = fsmount(dev);
+
+  bp = 0;
+  for(b = 0; b < mp->sb.size; b += BPB){
+    bp = bread(dev, BBLOCK(b, mp->sb));
+    for(bi = 0; bi < BPB && b + bi < mp->sb.size; bi++){
+      m = 1 << (bi % 8);
+      if((bp->data[bi/8] & m) == 0){  // Is block free?
+        bp->data[bi/8] |= m;  // Mark block in use.
+        log_write(bp);
+        brelse(bp);
+        if(zero)
+          bzero(dev, b + bi);
+        return b + bi;
+      }
+    }
+    brelse(bp);
+  }
+  panic("balloc: out of blocks");
+}
+
+// Allocate a zeroed disk block.
+static uint
+balloc(uint dev)
+{
+  return balloc1(dev, 1);
+}
+
+// Free a disk block.
+static void
+bfree(int dev, uint b)
+{
+  struct buf *bp;
+  int bi, m;
+
+  bp = bread(dev, BBLOCK(b, fsmount(dev)->sb));
+  bi = b % BPB;
+  m = 1 << (bi % 8);
+  if((bp->data[bi/8] & m) == 0)
+    panic("freeing free block");
+  bp->data[bi/8] &= ~m;
+  log_write(bp);
+  brelse(bp);
+}
+
+// Block reference counts (reflink).
+
+// 增加块 b 的共享引用。
+// Returns -1 if there is no refcount table or the count would overflow.
+static int
+bref(uint dev, uint b)
+{
+  struct buf *bp;
+  ushort *rc;
+
+  if(fsmount(dev)->sb.refstart == 0)
+    return -1;
+  bp = bread(dev, RBLOCK(b, fsmount(dev)->sb));
+  rc = (ushort*)bp->data + b % RPB;
+  if(*rc == 0xffff){
+    brelse(bp);
+    return -1;
+  }
+  (*rc)++;
+  log_write(bp);
+  brelse(bp);
+  return 0;
+}
+
+// 块 b 是否还被其他 inode（或间接块）共享。
+static int
+bshared(uint dev, uint b)
+{
+  struct buf *bp;
+  int n;
+
+  if(fsmount(dev)->sb.refstart == 0)
+    return 0;
+  bp = bread(dev, RBLOCK(b, fsmount(dev)->sb));
+  n = ((ushort*)bp->data)[b % RPB];
+  brelse(bp);
+  return n > 0;
+}
+
+// 放弃对块 b 的一个引用。b 仍被共享时只减少计数并返回 0；
+// 调用者是最后一个引用者时不做任何修改，返回 1，由调用者负责释放。
+// 计数的读改写在 refcount 块的睡眠锁下完成，因此并发放弃引用时
+// 恰好只有一方会拿到 1。
+static int
+bunshare(uint dev, uint b)
+{
+  struct buf *bp;
+  ushort *rc;
+
+  if(fsmount(dev)->sb.refstart == 0)
+    return 1;
+  bp = bread(dev, RBLOCK(b, fsmount(dev)->sb));
+  rc = (ushort*)bp->data + b % RPB;
+  if(*rc == 0){
+    brelse(bp);
+    return 1;
+  }
+  (*rc)--;
+  log_write(bp);
+  brelse(bp);
+  return 0;
+}
+
+// 放弃对以 addr 为根的块树的一个引用，level 为间接层数（0 为数据块）。
+// 只有最后一个引用者才会继续释放下层的块。
+static void
+bfreetree(uint dev, uint addr, int level)
+{
+  struct buf *bp;
+  uint *a;
+  int i;
+
+  if(!bunshare(dev, addr))
+    return;
+  if(level > 0){
+    bp = bread(dev, addr);
+    a = (uint*)bp->data;
+    for(i = 0; i < NINDIRECT; i++){
+      if(a[i])
+        bfreetree(dev, a[i], level - 1);
+    }
+    brelse(bp);
+  }
+  bfree(dev, addr);
+}
+
+// 复制共享的间接块时，下层每个块都要多一个引用，每个 refcount 块
+// 都要记入日志。一个事务只为此留出 NBOWNREF 个块，超出时写入失败，
+// 而不是让事务超过 MAXOPBLOCKS。
+#define NBOWNREF 2
+// reflink 在一个事务里给 dst 的所有顶层块增加引用，
+// 另外只写 dst 的 inode 块和 itrunc 可能写的位图块。
+#define NLINKREF (MAXOPBLOCKS-2)
+
+// 给 a[0..na) 中的每个块增加一个引用。涉及的 refcount 块
+// 超过 max 个，或者某个计数已满时不做修改，返回 -1。
+static int
+brefn(uint dev, uint *a, int na, int max)
+{
+  struct superblock *sb = &fsmount(dev)->sb;
+  uint rb[NLINKREF];
+  int i, j, n;
+
+  for(i = n = 0; i < na; i++){
+    if(a[i] == 0)
+      continue;
+    for(j = 0; j < n && rb[j] != RBLOCK(a[i], (*sb)); j++)
+      ;
+    if(j < n)
+      continue;
+    if(n == max)
+      return -1;
+    rb[n++] = RBLOCK(a[i], (*sb));
+  }
+
+  for(i = 0; i < na; i++){
+    if(a[i] && bref(dev, a[i]) < 0){
+      // 回滚已经增加的引用
+      while(--i >= 0){
+        if(a[i])
+          bunshare(dev, a[i]);
+      }
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// 给间接块内容 a 指向的每个块增加一个引用，见 brefn
+static int
+brefall(uint dev, uint *a)
+{
+  return brefn(dev, a, NINDIRECT, NBOWNREF);
+}
+
+// 保证 *slot 指向一个只属于调用者的块：为 0 时分配，
+// 被共享时复制一份（间接块的下层块随之多一个引用），再放弃对旧块的引用。
+// slot 位于 pbp 中时（pbp != 0）修改后记入日志。
+// 间接块的下层块无法增加引用时返回 0，*slot 不变。
+static uint
+bown(uint dev, uint *slot, int level, struct buf *pbp)
+{
+  uint old;
+  struct buf *obp, *nbp;
+
+  old = *slot;
+  if(old != 0 && !bshared(dev, old))
+    return old;
+
+  if(old != 0){
+    obp = bread(dev, old);
+    if(level > 0 && brefall(dev, (uint*)obp->data) < 0){
+      brelse(obp);
+      return 0;
+    }
+    *slot = balloc(dev);
+    nbp = bread(dev, *slot);
+    memmove(nbp->data, obp->data, BSIZE);
+    log_write(nbp);
+    brelse(obp);
+    brelse(nbp);
+    bfreetree(dev, old, level);
+  } else {
+    *slot = balloc(dev);
+  }
+  if(pbp)
+    log_write(pbp);
+  return *slot;
+}
 
-// 这里仅列出修改的两个函数
 // Inode content
 //
 // The content (data) associated with each inode is stored
@@ -29,14 +309,20 @@
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
 // listed in block ip->addrs[NDIRECT].
 
+static uint bmap_peek(struct inode*, uint);
+
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
+// 只读文件系统上只查找，不能分配：块不存在时返回 0。
 static uint
 bmap(struct inode *ip, uint bn)
 {
   uint addr, *a, *b;
   struct buf *bp, *db_bp;
 
+  if(fsrdonly(ip->dev))
+    return bmap_peek(ip, bn);
+
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
       ip->addrs[bn] = addr = balloc(ip->dev);
@@ -90,55 +376,1620 @@ bmap(struct inode *ip, uint bn)
   panic("bmap: out of range");
 }
 
+// bmapw 对第 bn 块槽位的操作
+#define BW_OWN   0   // 保证槽位指向只属于调用者的块
+#define BW_UNMAP 1   // 放弃槽位中的块并把槽位清零
+#define BW_RAW   2   // 同 BW_OWN，但新分配的块不清零
+
+// 写路径中对第 bn 块槽位执行 op，返回槽位中的块。
+static uint
+bslot(uint dev, uint *slot, struct buf *pbp, int op)
+{
+  uint addr;
+
+  if(op == BW_RAW && *slot == 0){
+    *slot = balloc1(dev, 0);
+    if(pbp)
+      log_write(pbp);
+    return *slot;
+  }
+  if(op != BW_UNMAP)
+    return bown(dev, slot, 0, pbp);
+  if((addr = *slot) != 0){
+    *slot = 0;
+    if(pbp)
+      log_write(pbp);
+    bfreetree(dev, addr, 0);
+  }
+  return 0;
+}
+
+// 写路径使用的 bmap：保证从 inode 到第 bn 块的整条路径都只属于 ip，
+// 路径上遇到 reflink 共享的块时先复制（copy-on-write），缺块时分配，
+// 最后对第 bn 块的槽位执行 op（BW_*）。
+// ip->addrs 可能改变，调用者负责 iupdate。
+// 路径上的共享间接块无法复制时返回 0。
+static uint
+bmapw(struct inode *ip, uint bn, int op)
+{
+  uint addr, *a, *b;
+  struct buf *bp, *db_bp;
+
+  if(bn < NDIRECT)
+    return bslot(ip->dev, &ip->addrs[bn], 0, op);
+  bn -= NDIRECT;
+
+  if(bn < NINDIRECT){
+    if((addr = bown(ip->dev, &ip->addrs[NDIRECT], 1, 0)) == 0)
+      return 0;
+    bp = bread(ip->dev, addr);
+    a = (uint*)bp->data;
+    addr = bslot(ip->dev, &a[bn], bp, op);
+    brelse(bp);
+    return addr;
+  }
+  bn -= NINDIRECT;
+
+  if(bn < ND_INDIRECT){
+    if((addr = bown(ip->dev, &ip->addrs[NDIRECT+1], 2, 0)) == 0)
+      return 0;
+    db_bp = bread(ip->dev, addr);
+    b = (uint*)db_bp->data;
+    if((addr = bown(ip->dev, &b[bn / NINDIRECT], 1, db_bp)) == 0){
+      brelse(db_bp);
+      return 0;
+    }
+    bp = bread(ip->dev, addr);
+    a = (uint*)bp->data;
+    addr = bslot(ip->dev, &a[bn % NINDIRECT], bp, op);
+    brelse(bp);
+    brelse(db_bp);
+    return addr;
+  }
+
+  panic("bmapw: out of range");
+}
+
+static uint
+bmap_cow(struct inode *ip, uint bn)
+{
+  return bmapw(ip, bn, BW_OWN);
+}
+
+// 释放文件的第 bn 块（共享时只减少引用）。
+// 路径上的共享间接块无法复制时返回 -1。
+static int
+bunmap(struct inode *ip, uint bn)
+{
+  // 已经是空洞（包括间接块不存在）时什么都不做，
+  // 否则 bmapw 会为了清一个空槽位去分配间接块
+  if(bmap_peek(ip, bn) == 0)
+    return 0;
+  bmapw(ip, bn, BW_UNMAP);
+  return bmap_peek(ip, bn) == 0 ? 0 : -1;
+}
+
+// 与 bmap 相同，但只查找不分配：块不存在时返回 0。
+// 用于预读等不应改变文件内容的场合。
+static uint
+bmap_peek(struct inode *ip, uint bn)
+{
+  uint addr;
+  struct buf *bp;
+
+  if(bn < NDIRECT)
+    return ip->addrs[bn];
+  bn -= NDIRECT;
+
+  if(bn < NINDIRECT){
+    if((addr = ip->addrs[NDIRECT]) == 0)
+      return 0;
+    bp = bread(ip->dev, addr);
+    addr = ((uint*)bp->data)[bn];
+    brelse(bp);
+    return addr;
+  }
+  bn -= NINDIRECT;
+
+  if(bn < ND_INDIRECT){
+    if((addr = ip->addrs[NDIRECT+1]) == 0)
+      return 0;
+    bp = bread(ip->dev, addr);
+    addr = ((uint*)bp->data)[bn / NINDIRECT];
+    brelse(bp);
+    if(addr == 0)
+      return 0;
+    bp = bread(ip->dev, addr);
+    addr = ((uint*)bp->data)[bn % NINDIRECT];
+    brelse(bp);
+    return addr;
+  }
+
+  return 0;
+}
+
 // Truncate inode (discard contents).
+// 与其他 inode 共享的块只减少引用计数，不会被释放。
 // Caller must hold ip->lock.
 void
 itrunc(struct inode *ip)
 {
-  int i, j;
-  struct buf *bp, *db_bp;
-  uint *a, *b;
+  int i;
+
+  if(ip->dev == TMPDEV){
+    tmpfs_trunc(ip);
+    ip->size = 0;
+    iupdate(ip);
+    return;
+  }
 
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
-      bfree(ip->dev, ip->addrs[i]);
+      bfreetree(ip->dev, ip->addrs[i], 0);
       ip->addrs[i] = 0;
     }
   }
 
   if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
-    }
-    brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
+    bfreetree(ip->dev, ip->addrs[NDIRECT], 1);
     ip->addrs[NDIRECT] = 0;
   }
 
   // 修改与bmap的修改对应，比较简单
   if (ip->addrs[NDIRECT+1]) {
-    db_bp = bread(ip->dev, ip->addrs[NDIRECT+1]);
-    b = (uint*)db_bp->data;
-    for (i = 0; i < NINDIRECT; ++i) {
-      if (b[i]) {
-        bp = bread(ip->dev, b[i]);
-        a = (uint*)bp->data;
-        for (j = 0; j < NINDIRECT; ++j) {
-          if (a[j])
-            bfree(ip->dev, a[j]);
-        }
-        brelse(bp);
-        bfree(ip->dev, b[i]);
-      }
-    }
-    brelse(db_bp);
-    bfree(ip->dev, ip->addrs[NDIRECT+1]);
+    bfreetree(ip->dev, ip->addrs[NDIRECT+1], 2);
     ip->addrs[NDIRECT+1] = 0;
   }
 
   ip->size = 0;
   iupdate(ip);
 }
+
+// O_DIRECT 读：与 readi 相同，但数据块经由 bread_direct 读取，
+// 未缓存的块不会进入 bcache，避免大文件流式读取冲掉元数据缓存。
+// Caller must hold ip->lock.
+int
+readi_direct(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+{
+  uint tot, m, addr;
+  struct buf *bp;
+
+  if(off > ip->size || off + n < off)
+    return 0;
+  if(off + n > ip->size)
+    n = ip->size - off;
+
+  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
+    if((addr = bmap(ip, off/BSIZE)) == 0)
+      return -1;
+    bp = bread_direct(ip->dev, addr);
+    m = min(n - tot, BSIZE - off%BSIZE);
+    if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
+      brelse(bp);
+      break;
+    }
+    brelse(bp);
+  }
+  return tot;
+}
+
+// O_DIRECT 写：整块覆盖时不必先把旧内容读入，未缓存的块直接写回原位，
+// 已缓存的块仍走日志，保证与 bcache 中的副本一致。
+// 新分配的块不经 bzero，在 direct 缓冲区中补零后整块写出。
+// Caller must hold ip->lock and be inside a transaction.
+int
+writei_direct(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  uint tot, m, addr;
+  int fresh;
+  struct buf *bp;
+
+  if(off > ip->size || off + n < off)
+    return -1;
+  if(off + n > MAXFILE*BSIZE)
+    return -1;
+
+  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
+    fresh = bmap_peek(ip, off/BSIZE) == 0;
+    if((addr = bmapw(ip, off/BSIZE, fresh ? BW_RAW : BW_OWN)) == 0){
+      n = -1;
+      break;
+    }
+    m = min(n - tot, BSIZE - off%BSIZE);
+    if(m == BSIZE || fresh){
+      bp = bget_direct(ip->dev, addr);
+      if(m < BSIZE)
+        memset(bp->data, 0, BSIZE);
+    } else
+      bp = bread_direct(ip->dev, addr);
+    if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
+      brelse(bp);
+      n = -1;
+      break;
+    }
+    bp->valid = 1;
+    bwrite_direct(bp);
+    brelse(bp);
+  }
+
+  if(n > 0 && off > ip->size)
+    ip->size = off;
+  // bmap_cow 可能已经换掉了共享块，即使出错也要写回 addrs
+  iupdate(ip);
+
+  return n;
+}
+
+// dentry 缓存：(dev, 目录 inum, 名字) -> inum，供 namex 不加目录的
+// 睡眠锁解析路径。每个桶一个自旋锁，桶内固定 NDWAY 项，轮流替换。
+// 只缓存存在的名字，"." 和 ".." 不缓存。目录项只会被 dirunlink 删除，
+// 它在持有目录锁时同步删掉对应的缓存项，所以缓存项总是有效的；
+// 删除目录要求目录为空，不会留下指向被复用 inum 的缓存项。
+#define NDBUCKET 31
+#define NDWAY    8
+#define DNAMELEN 28   // 只缓存短于此长度的名字
+
+struct dentry {
+  uint dev;
+  uint dir;           // 所在目录的 inum，0 表示空闲
+  uint inum;
+  uchar namelen;
+  char name[DNAMELEN];
+};
+
+static struct {
+  struct spinlock lock;
+  struct dentry e[NDWAY];
+  int next;           // 下一个替换的位置
+} dentcache[NDBUCKET];
+
+static uint
+dhash(uint dev, uint dir, char *name, int len)
+{
+  uint h = dev * 31 + dir;
+
+  for(int i = 0; i < len; i++)
+    h = h * 31 + (uchar)name[i];
+  return h % NDBUCKET;
+}
+
+static struct dentry*
+dfind(int b, uint dev, uint dir, char *name, int len)
+{
+  struct dentry *d;
+
+  for(d = dentcache[b].e; d < dentcache[b].e + NDWAY; d++){
+    if(d->dir == dir && d->dev == dev && d->namelen == len &&
+       strncmp(d->name, name, len) == 0)
+      return d;
+  }
+  return 0;
+}
+
+static int
+dcacheable(char *name, int len)
+{
+  if(len >= DNAMELEN)
+    return 0;
+  if(name[0] == '.' && (len == 1 || (len == 2 && name[1] == '.')))
+    return 0;
+  return 1;
+}
+
+// 记录目录 dp 中名为 name（len 字节）的项指向 inum。
+// Caller must hold dp->lock，只读文件系统上不需要。
+static void
+dcache_enter(struct inode *dp, char *name, int len, uint inum)
+{
+  struct dentry *d;
+  int b;
+
+  if(!dcacheable(name, len))
+    return;
+  b = dhash(dp->dev, dp->inum, name, len);
+  acquire(&dentcache[b].lock);
+  if((d = dfind(b, dp->dev, dp->inum, name, len)) == 0){
+    d = &dentcache[b].e[dentcache[b].next];
+    dentcache[b].next = (dentcache[b].next + 1) % NDWAY;
+  }
+  d->dev = dp->dev;
+  d->dir = dp->inum;
+  d->inum = inum;
+  d->namelen = len;
+  memmove(d->name, name, len);
+  release(&dentcache[b].lock);
+}
+
+// 删除目录 dp 中名字 name 的缓存项。
+// Caller must hold dp->lock.
+static void
+dcache_remove(struct inode *dp, char *name, int len)
+{
+  struct dentry *d;
+  int b;
+
+  if(!dcacheable(name, len))
+    return;
+  b = dhash(dp->dev, dp->inum, name, len);
+  acquire(&dentcache[b].lock);
+  if((d = dfind(b, dp->dev, dp->inum, name, len)) != 0)
+    d->dir = 0;
+  release(&dentcache[b].lock);
+}
+
+// 不加 dp 的睡眠锁，在缓存中查找 dp 下的 name。
+// 命中时返回引用计数已加一的 inode，未命中返回 0。
+// 在桶锁内 iget：缓存项还在说明还没有被 unlink，inode 不会被释放。
+static struct inode*
+dcache_lookup(struct inode *dp, char *name)
+{
+  struct dentry *d;
+  struct inode *ip = 0;
+  int len, b;
+
+  len = strlen(name);
+  if(!dcacheable(name, len))
+    return 0;
+  b = dhash(dp->dev, dp->inum, name, len);
+  acquire(&dentcache[b].lock);
+  if((d = dfind(b, dp->dev, dp->inum, name, len)) != 0)
+    ip = iget(d->dev, d->inum);
+  release(&dentcache[b].lock);
+  return ip;
+}
+
+// 卸载 dev 时丢掉它的所有缓存项
+static void
+dcache_purge(uint dev)
+{
+  struct dentry *d;
+
+  for(int b = 0; b < NDBUCKET; b++){
+    acquire(&dentcache[b].lock);
+    for(d = dentcache[b].e; d < dentcache[b].e + NDWAY; d++){
+      if(d->dev == dev)
+        d->dir = 0;
+    }
+    release(&dentcache[b].lock);
+  }
+}
+
+// 已从磁盘读入且是目录。持有 ip 的引用时 type 不会再变，
+// 不加睡眠锁读取；ilock 在设置 valid 之前发布了各字段。
+static int
+idirfast(struct inode *ip)
+{
+  return __atomic_load_n(&ip->valid, __ATOMIC_ACQUIRE) && ip->type == T_DIR;
+}
+
+void
+iinit()
+{
+  int i = 0;
+  
+  initlock(&icache.lock, "icache");
+  for(i = 0; i < NINODE; i++) {
+    initsleeplock(&icache.inode[i].lock, "inode");
+  }
+  for(i = 0; i < NDBUCKET; i++)
+    initlock(&dentcache[i].lock, "dentcache");
+}
+
+// Allocate an inode on device dev.
+// Mark it as allocated by  giving it type type.
+// Returns an unlocked but allocated and referenced inode.
+struct inode*
+ialloc(uint dev, short type)
+{
+  int inum;
+  struct buf *bp;
+  struct dinode *dip;
+  struct mount *m;
+
+  // tmpfs 的 inode 用完时返回 0
+  if(dev == TMPDEV)
+    return (inum = tmpfs_ialloc(type)) ? iget(dev, inum) : 0;
+
+  m = fsmount(dev);
+  for(inum = 1; inum < m->sb.ninodes; inum++){
+    bp = bread(dev, IBLOCK(inum, m->sb));
+    dip = (struct dinode*)bp->data + inum%IPB;
+    if(dip->type == 0){  // a free inode
+      memset(dip, 0, sizeof(*dip));
+      dip->type = type;
+      log_write(bp);   // mark it allocated on the disk
+      brelse(bp);
+      return iget(dev, inum);
+    }
+    brelse(bp);
+  }
+  panic("ialloc: no inodes");
+}
+
+// 把 type、nlink、size 发布到 stat 快照。
+// Caller must hold ip->lock，所以写者之间不会并发。
+static void
+ipublish(struct inode *ip)
+{
+  __atomic_store_n(&ip->seq, ip->seq + 1, __ATOMIC_RELAXED);
+  __sync_synchronize();
+  ip->stype = ip->type;
+  ip->snlink = ip->nlink;
+  ip->ssize = ip->size;
+  __atomic_store_n(&ip->seq, ip->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Lock the given inode.
+// Reads the inode from disk if necessary.
+void
+ilock(struct inode *ip)
+{
+  struct buf *bp;
+  struct dinode *dip;
+
+  if(ip == 0 || ip->ref < 1)
+    panic("ilock");
+
+  acquiresleep(&ip->lock);
+
+  if(ip->valid == 0){
+    if(ip->dev == TMPDEV){
+      tmpfs_load(ip);
+    } else {
+      bp = bread(ip->dev, IBLOCK(ip->inum, fsmount(ip->dev)->sb));
+      dip = (struct dinode*)bp->data + ip->inum%IPB;
+      ip->type = dip->type;
+      ip->major = dip->major;
+      ip->minor = dip->minor;
+      ip->nlink = dip->nlink;
+      ip->flags = dip->flags;
+      ip->size = dip->size;
+      memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
+      brelse(bp);
+    }
+    // icache 槽位可能刚被另一个文件用过，清掉上一个文件的提示
+    ip->advice = FADV_NORMAL;
+    ip->ranext = 0;
+    ipublish(ip);
+    __atomic_store_n(&ip->valid, 1, __ATOMIC_RELEASE);
+    if(ip->type == 0)
+      panic("ilock: no type");
+  }
+}
+
+#define ZCSIZE (ZCLUSTER*BSIZE)   // 一簇的字节数，等于 PGSIZE
+
+// 把第 c 簇在文件中的内容读到 buf（ZCSIZE 字节），返回有效字节数。
+// zbuf 是存放压缩数据的临时空间。磁盘上的压缩数据损坏时返回 -1。
+// Caller must hold ip->lock.
+static int
+zload(struct inode *ip, uint c, char *buf, char *zbuf)
+{
+  uint addrs[ZCLUSTER];
+  uint base, len, need, nslot, i;
+  struct buf *bp;
+  struct zhdr *zh;
+
+  base = c * ZCSIZE;
+  if(base >= ip->size)
+    return 0;
+  len = min(ip->size - base, ZCSIZE);
+  need = (len + BSIZE - 1) / BSIZE;
+  for(nslot = 0; nslot < need; nslot++){
+    if((addrs[nslot] = bmap_peek(ip, c * ZCLUSTER + nslot)) == 0)
+      break;
+  }
+
+  // 未压缩的簇：各块原样存放
+  if(nslot == need){
+    for(i = 0; i < need; i++){
+      bp = bread(ip->dev, addrs[i]);
+      memmove(buf + i*BSIZE, bp->data, BSIZE);
+      brelse(bp);
+    }
+    return len;
+  }
+
+  for(i = 0; i < nslot; i++){
+    bp = bread(ip->dev, addrs[i]);
+    memmove(zbuf + i*BSIZE, bp->data, BSIZE);
+    brelse(bp);
+  }
+  zh = (struct zhdr*)zbuf;
+  if(nslot == 0 || zh->rawlen != len || sizeof(*zh) + zh->zlen > nslot*BSIZE ||
+     lz_decompress((uchar*)(zh+1), zh->zlen, (uchar*)buf, ZCSIZE) != len)
+    return -1;
+  return len;
+}
+
+// 把 data 的前 nblk 块写到从逻辑块 bn 开始的槽位。
+// Returns 0, or -1 if a block could not be mapped.
+static int
+zstore(struct inode *ip, uint bn, char *data, uint nblk)
+{
+  struct buf *bp;
+  uint i, addr;
+
+  for(i = 0; i < nblk; i++){
+    if((addr = bmap_cow(ip, bn + i)) == 0)
+      return -1;
+    bp = bread(ip->dev, addr);
+    memmove(bp->data, data + i*BSIZE, BSIZE);
+    log_write(bp);
+    brelse(bp);
+  }
+  return 0;
+}
+
+// 压缩文件的 readi：逐簇解压后复制给调用者。
+static int
+zreadi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+{
+  uint tot, m;
+  char *buf, *zbuf;
+
+  if(off > ip->size || off + n < off)
+    return 0;
+  if(off + n > ip->size)
+    n = ip->size - off;
+  if((buf = kalloc()) == 0)
+    return -1;
+  if((zbuf = kalloc()) == 0){
+    kfree(buf);
+    return -1;
+  }
+
+  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
+    m = min(n - tot, ZCSIZE - off%ZCSIZE);
+    if(zload(ip, off / ZCSIZE, buf, zbuf) < 0){
+      tot = -1;
+      break;
+    }
+    if(either_copyout(user_dst, dst, buf + off%ZCSIZE, m) == -1)
+      break;
+  }
+
+  kfree(zbuf);
+  kfree(buf);
+  return tot;
+}
+
+// 压缩文件的 writei：对涉及的每一簇读出、修改、重新压缩。
+// 压缩后能少占至少一个块才按压缩格式存放，否则原样存放；
+// 多出的槽位释放掉。簇是否压缩由文件大小判定，所以每写完一簇
+// 就更新 ip->size。
+// Caller must hold ip->lock and be inside a transaction; filewrite
+// keeps each transaction within a single cluster.
+static int
+zwritei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  uint tot, m, c, coff, len, need, nblk, i;
+  char *buf, *zbuf;
+  struct zhdr *zh;
+  int z, r;
+
+  if(off > ip->size || off + n < off)
+    return -1;
+  if(off + n > MAXFILE*BSIZE)
+    return -1;
+  if((buf = kalloc()) == 0)
+    return -1;
+  if((zbuf = kalloc()) == 0){
+    kfree(buf);
+    return -1;
+  }
+
+  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
+    c = off / ZCSIZE;
+    coff = off % ZCSIZE;
+    m = min(n - tot, ZCSIZE - coff);
+    if((z = zload(ip, c, buf, zbuf)) < 0){
+      n = -1;
+      break;
+    }
+    len = z;
+    if(either_copyin(buf + coff, user_src, src, m) == -1){
+      n = -1;
+      break;
+    }
+    if(coff + m > len)
+      len = coff + m;
+
+    need = (len + BSIZE - 1) / BSIZE;
+    zh = (struct zhdr*)zbuf;
+    z = lz_compress((uchar*)buf, len, (uchar*)(zh+1), ZCSIZE - sizeof(*zh));
+    if(z >= 0 && (nblk = (sizeof(*zh) + z + BSIZE - 1) / BSIZE) < need){
+      zh->zlen = z;
+      zh->rawlen = len;
+      r = zstore(ip, c * ZCLUSTER, zbuf, nblk);
+    } else {
+      r = zstore(ip, c * ZCLUSTER, buf, need);
+      nblk = need;
+    }
+    for(i = nblk; i < ZCLUSTER && r == 0; i++){
+      if(bmap_peek(ip, c * ZCLUSTER + i))
+        r = bunmap(ip, c * ZCLUSTER + i);
+    }
+    if(r < 0){
+      n = -1;
+      break;
+    }
+
+    if(off + m > ip->size)
+      ip->size = off + m;
+  }
+
+  kfree(zbuf);
+  kfree(buf);
+  iupdate(ip);
+  return n;
+}
+
+#define NREADAHEAD 8   // FADV_SEQUENTIAL 时向前预读的块数
+#define NWILLNEED  32  // 一次 FADV_WILLNEED 最多预取的块数，约为 bcache 的一半
+#define NIPREFETCH 8   // 每个目录块最多预取的 inode 块数
+
+// 把逻辑块 [bn, bn+n) 中已分配的块读入 bcache。
+// Caller must hold ip->lock.
+static void
+iprefetch(struct inode *ip, uint bn, uint n)
+{
+  uint addr, end;
+
+  end = (ip->size + BSIZE - 1) / BSIZE;
+  if(bn + n < end)
+    end = bn + n;
+  for(; bn < end; bn++){
+    if((addr = bmap_peek(ip, bn)) != 0)
+      bprefetch(ip->dev, addr);
+  }
+}
+
+// Read data from inode.
+// Caller must hold ip->lock.
+// If user_dst==1, then dst is a user virtual address;
+// otherwise, dst is a kernel address.
+int
+readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+{
+  uint tot, m, bn, addr;
+  struct buf *bp;
+
+  if(ip->dev == TMPDEV)
+    return tmpfs_readi(ip, user_dst, dst, off, n);
+  if(ip->flags & DI_COMPRESS)
+    return zreadi(ip, user_dst, dst, off, n);
+
+  if(off > ip->size || off + n < off)
+    return 0;
+  if(off + n > ip->size)
+    n = ip->size - off;
+
+  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
+    // 只读文件系统上的空洞无法读出
+    if((addr = bmap(ip, off/BSIZE)) == 0)
+      return -1;
+    bp = bread(ip->dev, addr);
+    m = min(n - tot, BSIZE - off%BSIZE);
+    if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
+      brelse(bp);
+      break;
+    }
+    // 顺序扫描时，读到块尾的块不会再被用到
+    if(ip->advice == FADV_SEQUENTIAL && (off + m) % BSIZE == 0)
+      brelse_cold(bp);
+    else
+      brelse(bp);
+  }
+
+  // 顺序读：保持 off 之后 NREADAHEAD 个块在 bcache 中，
+  // ranext 记录已经预读到哪里，避免每次都重新检查整个窗口
+  if(ip->advice == FADV_SEQUENTIAL && tot > 0){
+    bn = off / BSIZE;
+    if(ip->ranext < bn)
+      ip->ranext = bn;
+    if(ip->ranext < bn + NREADAHEAD){
+      iprefetch(ip, ip->ranext, bn + NREADAHEAD - ip->ranext);
+      ip->ranext = bn + NREADAHEAD;
+    }
+  }
+  return tot;
+}
+
+// 处理 fadvise：记录访问模式，或对 [off, off+len) 预取/丢弃缓存块，
+// len == 0 表示直到文件末尾。
+// Caller must hold ip->lock.
+int
+ifadvise(struct inode *ip, uint off, uint len, int advice)
+{
+  uint bn, end, addr;
+
+  end = ip->size;
+  if(len != 0 && off + len >= off && off + len < end)
+    end = off + len;
+
+  switch(advice){
+  case FADV_NORMAL:
+  case FADV_RANDOM:
+  case FADV_SEQUENTIAL:
+    ip->advice = advice;
+    ip->ranext = 0;
+    return 0;
+  case FADV_WILLNEED:
+    // tmpfs 的数据总在内存中，不需要预读和丢弃
+    if(ip->dev == TMPDEV)
+      return 0;
+    if(off < end)
+      iprefetch(ip, off / BSIZE, min((end - off + BSIZE - 1) / BSIZE, NWILLNEED));
+    return 0;
+  case FADV_DONTNEED:
+    if(ip->dev == TMPDEV)
+      return 0;
+    for(bn = off / BSIZE; bn * BSIZE < end; bn++){
+      if((addr = bmap_peek(ip, bn)) != 0)
+        bdrop(ip->dev, addr);
+    }
+    return 0;
+  }
+  return -1;
+}
+
+// Write data to inode.
+// Caller must hold ip->lock.
+// If user_src==1, then src is a user virtual address;
+// otherwise, src is a kernel address.
+int
+writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  uint tot, m, addr;
+  struct buf *bp;
+
+  if(ip->dev == TMPDEV)
+    return tmpfs_writei(ip, user_src, src, off, n);
+  if(ip->flags & DI_COMPRESS)
+    return zwritei(ip, user_src, src, off, n);
+
+  if(off > ip->size || off + n < off)
+    return -1;
+  if(off + n > MAXFILE*BSIZE)
+    return -1;
+
+  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
+    if((addr = bmap_cow(ip, off/BSIZE)) == 0){
+      n = -1;
+      break;
+    }
+    bp = bread(ip->dev, addr);
+    m = min(n - tot, BSIZE - off%BSIZE);
+    if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
+      brelse(bp);
+      n = -1;
+      break;
+    }
+    log_write(bp);
+    brelse(bp);
+  }
+
+  if(n > 0 && off > ip->size)
+    ip->size = off;
+  // write the i-node back to disk even if the size didn't change
+  // because the loop above might have called bmap_cow() and added
+  // or replaced a block in ip->addrs[].  在出错时也要写回：
+  // 被替换的共享块的引用已经放弃，磁盘上的 inode 不能再指向它。
+  iupdate(ip);
+
+  return n;
+}
+
+// reflink：让空文件 dst 共享 src 的全部数据块和间接块。
+// 只增加 addrs[] 中顶层块的引用计数，开销与文件大小无关；
+// 之后任何一方写入时由 bmap_cow 复制被写到的路径。
+// 顶层块分布在超过 NLINKREF 个 refcount 块上时失败，不让事务超限。
+// Caller must hold both locks and be inside a transaction.
+int
+ireflink(struct inode *src, struct inode *dst)
+{
+  if(src->type != T_FILE || dst->type != T_FILE || dst->size != 0)
+    return -1;
+  if(src->dev != dst->dev || fsmount(src->dev)->sb.refstart == 0)
+    return -1;
+
+  itrunc(dst);
+  if(brefn(src->dev, src->addrs, NDIRECT+2, NLINKREF) < 0)
+    return -1;
+  memmove(dst->addrs, src->addrs, sizeof(dst->addrs));
+  dst->flags = src->flags;  // 压缩文件的块布局不同，标志必须一起带过去
+  dst->size = src->size;
+  iupdate(dst);
+  return 0;
+}
+
+// Copy a modified in-memory inode to disk.
+// Must be called after every change to an ip->xxx field
+// that lives on disk, since i-node cache is write-through.
+// Caller must hold ip->lock.
+void
+iupdate(struct inode *ip)
+{
+  struct buf *bp;
+  struct dinode *dip;
+
+  if(ip->dev == TMPDEV){
+    tmpfs_store(ip);
+    ipublish(ip);
+    return;
+  }
+
+  bp = bread(ip->dev, IBLOCK(ip->inum, fsmount(ip->dev)->sb));
+  dip = (struct dinode*)bp->data + ip->inum%IPB;
+  dip->type = ip->type;
+  dip->major = ip->major;
+  dip->minor = ip->minor;
+  dip->flags = ip->flags;
+  dip->nlink = ip->nlink;
+  dip->size = ip->size;
+  memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
+  log_write(bp);
+  brelse(bp);
+  ipublish(ip);
+}
+
+// 不加锁，从 ipublish 发布的快照复制 stat 信息。
+// 快照正在更新时重试几次；inode 尚未读入或一直在更新时
+// 返回 -1，调用者改为加锁调用 stati。
+// Caller must hold a reference to ip.
+int
+stati_nolock(struct inode *ip, struct stat *st)
+{
+  uint seq;
+
+  if(!__atomic_load_n(&ip->valid, __ATOMIC_ACQUIRE))
+    return -1;
+  for(int i = 0; i < 4; i++){
+    seq = __atomic_load_n(&ip->seq, __ATOMIC_ACQUIRE);
+    if(seq & 1)
+      continue;
+    st->type = ip->stype;
+    st->nlink = ip->snlink;
+    st->size = ip->ssize;
+    __sync_synchronize();
+    if(__atomic_load_n(&ip->seq, __ATOMIC_RELAXED) == seq){
+      st->dev = ip->dev;
+      st->ino = ip->inum;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+// Directories
+
+// 块内偏移 off 处的目录项。检查 reclen，损坏时返回 0，
+// 调用者让操作失败，而不是让坏的镜像拖垮内核。
+static struct dirent*
+dirent_at(char *blk, uint off)
+{
+  struct dirent *de = (struct dirent*)(blk + off);
+
+  if(de->reclen < sizeof(*de) || de->reclen % 4 != 0 || off + de->reclen > BSIZE ||
+     (de->inum && DIRENT_SIZE(de->namelen) > de->reclen))
+    return 0;
+  return de;
+}
+
+// 把目录块 blk 中各项 inode 所在的 inode 块读入 bcache，
+// 按块号从小到大，最多 NIPREFETCH 块。读目录之后逐项 stat 或 open
+// 时，iget/ilock 读 inode 多数能命中缓存，磁盘也按顺序访问。
+// 只在 getdents（dirlist）中使用，readi 读目录时不预取。
+static void
+diriprefetch(uint dev, char *blk)
+{
+  uint ib, next, last, o;
+  int k;
+  struct dirent *de;
+  struct mount *m = fsmount(dev);
+
+  for(k = 0, last = 0; k < NIPREFETCH; k++, last = next){
+    next = 0;
+    for(o = 0; o < BSIZE; o += de->reclen){
+      if((de = dirent_at(blk, o)) == 0)
+        break;
+      if(de->inum == 0 || de->inum >= m->sb.ninodes)
+        continue;
+      ib = IBLOCK(de->inum, m->sb);
+      if(ib > last && (next == 0 || ib < next))
+        next = ib;
+    }
+    if(next == 0)
+      break;
+    bprefetch(dev, next);
+  }
+}
+
+// 目录的第 bn 块。磁盘文件系统上是 bcache 中的块，*bpp 返回它的 buf；
+// tmpfs 上直接是数据页中的一段，*bpp 为 0。
+// tmpfs 上需要新分配而内存不足时，或只读文件系统上块不存在时返回 0。
+static char*
+dirblock(struct inode *dp, uint bn, struct buf **bpp)
+{
+  uint addr;
+
+  *bpp = 0;
+  if(dp->dev == TMPDEV)
+    return tmpfs_block(dp, bn, 1);
+  if((addr = bmap(dp, bn)) == 0)
+    return 0;
+  *bpp = bread(dp->dev, addr);
+  return (char*)(*bpp)->data;
+}
+
+// 用完 dirblock 返回的块，dirty 时记入日志
+static void
+dirrelse(struct buf *bp, int dirty)
+{
+  if(bp == 0)
+    return;
+  if(dirty)
+    log_write(bp);
+  brelse(bp);
+}
+
+// Look for a directory entry in a directory.
+// If found, set *poff to byte offset of entry.
+// Caller must hold dp->lock，只读文件系统上只需 dp 已读入。
+// 按块读入目录，每块只 bread 一次。
+struct inode*
+dirlookup(struct inode *dp, char *name, uint *poff)
+{
+  uint off, o, inum;
+  int len;
+  struct buf *bp;
+  char *blk;
+  struct dirent *de;
+
+  if(dp->type != T_DIR)
+    panic("dirlookup not DIR");
+
+  len = strlen(name);
+  if(len > DIRSIZ)
+    len = DIRSIZ;
+  for(off = 0; off < dp->size; off += BSIZE){
+    if((blk = dirblock(dp, off / BSIZE, &bp)) == 0)
+      continue;
+    for(o = 0; o < BSIZE; o += de->reclen){
+      if((de = dirent_at(blk, o)) == 0){
+        dirrelse(bp, 0);
+        return 0;
+      }
+      if(de->inum == 0 || de->namelen != len || strncmp(de->name, name, len) != 0)
+        continue;
+      // entry matches path element
+      if(poff)
+        *poff = off + o;
+      inum = de->inum;
+      dirrelse(bp, 0);
+      dcache_enter(dp, name, len, inum);
+      return iget(dp->dev, inum);
+    }
+    dirrelse(bp, 0);
+  }
+
+  return 0;
+}
+
+// Write a new directory entry (name, inum) into the directory dp.
+// 优先放进空闲项或某项 reclen 中多余的空间，都放不下时在目录末尾加一块。
+int
+dirlink(struct inode *dp, char *name, uint inum)
+{
+  uint off, o, used, need;
+  int len;
+  struct buf *bp;
+  char *blk;
+  struct dirent *de, *nde;
+  struct inode *ip;
+
+  // Check that name is not present.
+  if((ip = dirlookup(dp, name, 0)) != 0){
+    iput(ip);
+    return -1;
+  }
+
+  len = strlen(name);
+  if(len > DIRSIZ)
+    len = DIRSIZ;
+  need = DIRENT_SIZE(len);
+
+  for(off = 0; off < dp->size; off += BSIZE){
+    if((blk = dirblock(dp, off / BSIZE, &bp)) == 0)
+      return -1;
+    for(o = 0; o < BSIZE; o += de->reclen){
+      if((de = dirent_at(blk, o)) == 0){
+        dirrelse(bp, 0);
+        return -1;
+      }
+      used = de->inum ? DIRENT_SIZE(de->namelen) : 0;
+      if(de->reclen - used < need)
+        continue;
+      if(used){
+        // 从这一项的尾部切出新项
+        nde = (struct dirent*)((char*)de + used);
+        nde->reclen = de->reclen - used;
+        de->reclen = used;
+        de = nde;
+      }
+      goto found;
+    }
+    dirrelse(bp, 0);
+  }
+
+  // 目录末尾加一块，新项占满整块
+  if((blk = dirblock(dp, dp->size / BSIZE, &bp)) == 0)
+    return -1;
+  memset(blk, 0, BSIZE);
+  de = (struct dirent*)blk;
+  de->reclen = BSIZE;
+  dp->size += BSIZE;
+  iupdate(dp);
+
+found:
+  de->inum = inum;
+  de->namelen = len;
+  memmove(de->name, name, len);
+  dirrelse(bp, 1);
+  return 0;
+}
+
+// 删除目录 dp 中偏移 off 处（dirlookup 返回的）目录项。
+// 它的空间并入块内前一项；是块内第一项时只清零 inum。
+// Returns 0 on success, -1 if the directory block is corrupt.
+int
+dirunlink(struct inode *dp, uint off)
+{
+  uint o, prev;
+  struct buf *bp;
+  char *blk;
+  struct dirent *de;
+
+  if((blk = dirblock(dp, off / BSIZE, &bp)) == 0)
+    return -1;
+  prev = BSIZE;
+  for(o = 0; o < off % BSIZE; o += de->reclen){
+    if((de = dirent_at(blk, o)) == 0)
+      break;
+    prev = o;
+  }
+  if(o != off % BSIZE || (de = dirent_at(blk, o)) == 0){
+    dirrelse(bp, 0);
+    return -1;
+  }
+  dcache_remove(dp, de->name, de->namelen);
+  if(prev == BSIZE)
+    de->inum = 0;
+  else
+    dirent_at(blk, prev)->reclen += de->reclen;
+  dirrelse(bp, 1);
+  return 0;
+}
+
+// 填入 dst 中 len 字节 gdent 记录的类型和大小。
+// 按 inode 块号从小到大读，每个 inode 块只 bread 一次。
+static void
+dirstat(uint dev, char *dst, int len)
+{
+  uint blk, next, last;
+  int o;
+  struct buf *bp;
+  struct gdent *g;
+  struct dinode *dip;
+  struct mount *m;
+
+  // tmpfs 的 inode 在内存中
+  if(dev == TMPDEV){
+    for(o = 0; o < len; o += g->reclen){
+      g = (struct gdent*)(dst + o);
+      tmpfs_stat(g->inum, &g->type, &g->size);
+    }
+    return;
+  }
+
+  m = fsmount(dev);
+
+  for(last = 0; ; last = next){
+    next = 0;
+    for(o = 0; o < len; o += g->reclen){
+      g = (struct gdent*)(dst + o);
+      blk = IBLOCK(g->inum, m->sb);
+      if(g->inum < m->sb.ninodes && blk > last && (next == 0 || blk < next))
+        next = blk;
+    }
+    if(next == 0)
+      break;
+    bp = bread(dev, next);
+    for(o = 0; o < len; o += g->reclen){
+      g = (struct gdent*)(dst + o);
+      if(g->inum >= m->sb.ninodes || IBLOCK(g->inum, m->sb) != next)
+        continue;
+      dip = (struct dinode*)bp->data + g->inum%IPB;
+      g->type = dip->type;
+      g->size = dip->size;
+    }
+    brelse(bp);
+  }
+}
+
+// 从目录偏移 *offp 开始，把有效目录项转换成 struct gdent 写入 dst，
+// 最多 n 字节，只写完整的记录。*offp 前进到第一个未返回的目录项。
+// flags 含 GD_STAT 时再填入各项的类型和大小。
+// Returns bytes written, 0 at end of directory, or -1 if *offp is not
+// at an entry or n cannot hold the next entry.
+// Caller must hold dp->lock.
+int
+dirlist(struct inode *dp, uint *offp, char *dst, int n, int flags)
+{
+  uint off, base, o;
+  int len;
+  struct buf *bp;
+  char *blk;
+  struct dirent *de;
+  struct gdent *g;
+
+  if(dp->type != T_DIR)
+    return -1;
+
+  len = 0;
+  off = *offp;
+  while(off < dp->size){
+    base = off - off % BSIZE;
+    if((blk = dirblock(dp, base / BSIZE, &bp)) == 0){
+      if(len == 0)
+        return -1;
+      goto out;
+    }
+    for(o = 0; o < off - base; o += de->reclen){
+      if((de = dirent_at(blk, o)) == 0)
+        break;
+    }
+    if(o != off - base){
+      dirrelse(bp, 0);
+      return -1;
+    }
+    if(off == base && bp && !(flags & GD_STAT))
+      diriprefetch(dp->dev, blk);
+    for(; o < BSIZE; o += de->reclen){
+      if((de = dirent_at(blk, o)) == 0){
+        dirrelse(bp, 0);
+        off = base + o;
+        if(len == 0)
+          return -1;
+        goto out;
+      }
+      if(de->inum == 0)
+        continue;
+      if(len + GDENT_SIZE(de->namelen) > n){
+        dirrelse(bp, 0);
+        off = base + o;
+        if(len == 0)
+          return -1;
+        goto out;
+      }
+      g = (struct gdent*)(dst + len);
+      g->inum = de->inum;
+      g->size = 0;
+      g->reclen = GDENT_SIZE(de->namelen);
+      g->namelen = de->namelen;
+      g->type = 0;
+      memmove(g->name, de->name, de->namelen);
+      g->name[de->namelen] = 0;
+      len += g->reclen;
+    }
+    dirrelse(bp, 0);
+    off = base + BSIZE;
+  }
+
+out:
+  *offp = off;
+  if(flags & GD_STAT)
+    dirstat(dp->dev, dst, len);
+  return len;
+}
+
+// Copy the next path element from path into name.
+// Return a pointer to the element following the copied one.
+// The returned path has no leading slashes,
+// so the caller can check *path=='\0' to see if the name is the last one.
+// If no name to remove, return 0.
+// name must have room for DIRSIZ+1 bytes; longer elements
+// are truncated to DIRSIZ.
+//
+// Examples:
+//   skipelem("a/bb/c", name) = "bb/c", setting name = "a"
+//   skipelem("///a//bb", name) = "bb", setting name = "a"
+//   skipelem("a", name) = "", setting name = "a"
+//   skipelem("", name) = skipelem("////", name) = 0
+//
+static char*
+skipelem(char *path, char *name)
+{
+  char *s;
+  int len;
+
+  while(*path == '/')
+    path++;
+  if(*path == 0)
+    return 0;
+  s = path;
+  while(*path != '/' && *path != 0)
+    path++;
+  len = path - s;
+  if(len > DIRSIZ)
+    len = DIRSIZ;
+  memmove(name, s, len);
+  name[len] = 0;
+  while(*path == '/')
+    path++;
+  return path;
+}
+
+// ip 是挂载点时换成被挂载文件系统的根目录
+static struct inode*
+mntcross(struct inode *ip)
+{
+  struct mount *m;
+  struct inode *root = 0;
+
+  if(!ip->mounted)
+    return ip;
+  acquire(&mtab.lock);
+  for(m = mtab.m; m < mtab.m + NMOUNT; m++){
+    if(m->dev && m->mntpt == ip){
+      root = idup(m->root);
+      break;
+    }
+  }
+  release(&mtab.lock);
+  if(root == 0)
+    return ip;
+  iput(ip);
+  return root;
+}
+
+// ip 是被挂载文件系统的根目录，换成它的挂载点
+static struct inode*
+mntuncross(struct inode *ip)
+{
+  struct mount *m;
+  struct inode *mp = 0;
+
+  acquire(&mtab.lock);
+  for(m = mtab.m; m < mtab.m + NMOUNT; m++){
+    if(m->dev == ip->dev && m->mntpt){
+      mp = idup(m->mntpt);
+      break;
+    }
+  }
+  release(&mtab.lock);
+  if(mp == 0)
+    return ip;
+  iput(ip);
+  return mp;
+}
+
+// Look up and return the inode for a path name.
+// If parent != 0, return the inode for the parent and copy the final
+// path element into name, which must have room for DIRSIZ+1 bytes.
+// Must be called inside a transaction since it calls iput().
+// 每个路径分量先查 dentry 缓存，命中时不加目录的睡眠锁，
+// 未命中再加锁调用 dirlookup（它会把结果放进缓存）。
+// 相对路径从 start 开始解析，start 为 0 时从当前目录开始。
+static struct inode*
+namex(struct inode *start, char *path, int nameiparent, char *name)
+{
+  struct inode *ip, *next;
+
+  if(*path == '/')
+    ip = iget(ROOTDEV, ROOTINO);
+  else if(start)
+    ip = idup(start);
+  else
+    ip = idup(myproc()->cwd);
+
+  while((path = skipelem(path, name)) != 0){
+    // 被挂载文件系统的根目录的 ".." 在挂载点所在的目录中查找
+    if(ip->inum == ROOTINO && ip->dev != ROOTDEV && namecmp(name, "..") == 0)
+      ip = mntuncross(ip);
+    if(!(nameiparent && *path == '\0') && idirfast(ip) &&
+       (next = dcache_lookup(ip, name)) != 0){
+      iput(ip);
+      ip = mntcross(next);
+      continue;
+    }
+    // 只读文件系统上目录内容不会改变，已读入的目录不加锁查找
+    if(!(nameiparent && *path == '\0') && idirfast(ip) && fsrdonly(ip->dev)){
+      next = dirlookup(ip, name, 0);
+      iput(ip);
+      if(next == 0)
+        return 0;
+      ip = mntcross(next);
+      continue;
+    }
+    ilock(ip);
+    if(ip->type != T_DIR){
+      iunlockput(ip);
+      return 0;
+    }
+    if(nameiparent && *path == '\0'){
+      // Stop one level early.
+      iunlock(ip);
+      return ip;
+    }
+    if((next = dirlookup(ip, name, 0)) == 0){
+      iunlockput(ip);
+      return 0;
+    }
+    iunlockput(ip);
+    ip = mntcross(next);
+  }
+  if(nameiparent){
+    iput(ip);
+    return 0;
+  }
+  return ip;
+}
+
+struct inode*
+namei(char *path)
+{
+  char name[DIRSIZ+1];
+  return namex(0, path, 0, name);
+}
+
+struct inode*
+nameiparent(char *path, char *name)
+{
+  return namex(0, path, 1, name);
+}
+
+// 以目录 dp 为起点解析 path，供 *at 系统调用使用
+struct inode*
+nameiat(struct inode *dp, char *path)
+{
+  char name[DIRSIZ+1];
+  return namex(dp, path, 0, name);
+}
+
+struct inode*
+nameiparentat(struct inode *dp, char *path, char *name)
+{
+  return namex(dp, path, 1, name);
+}
+
+// 在 dev 上建立一个空文件系统，共 size 块：布局与 mkfs 相同，
+// 根目录只有 "." 和 ".."。直接 bwrite，不经过日志。
+// 在 log_freeze() 之后调用。
+static void
+fsformat(uint dev, uint size)
+{
+  struct superblock s;
+  uint ninodes, nbitmap, nref, nmeta, b, i;
+  struct buf *bp;
+  struct dinode *dip;
+  struct dirent *de;
+
+  ninodes = size / 8;
+  nbitmap = size / BPB + 1;
+  nref = size / RPB + 1;
+  memset(&s, 0, sizeof(s));
+  s.magic = FSMAGIC;
+  s.size = size;
+  s.ninodes = ninodes;
+  s.nlog = LOGSIZE;
+  s.logstart = 2;
+  s.inodestart = 2 + LOGSIZE;
+  s.bmapstart = s.inodestart + ninodes / IPB + 1;
+  s.refstart = s.bmapstart + nbitmap;
+  nmeta = s.refstart + nref;
+  s.nblocks = size - nmeta;
+
+  // 元数据块和根目录的数据块（第 nmeta 块）
+  for(b = 0; b <= nmeta; b++){
+    bp = bread(dev, b);
+    memset(bp->data, 0, BSIZE);
+    if(b == 1)
+      memmove(bp->data, &s, sizeof(s));
+    if(b >= s.bmapstart && b < s.refstart){
+      for(i = 0; i <= nmeta; i++){
+        if(BBLOCK(i, s) == b)
+          bp->data[(i % BPB) / 8] |= 1 << (i % 8);
+      }
+    }
+    if(b == IBLOCK(ROOTINO, s)){
+      dip = (struct dinode*)bp->data + ROOTINO%IPB;
+      dip->type = T_DIR;
+      dip->nlink = 1;
+      dip->size = BSIZE;
+      dip->addrs[0] = nmeta;
+    }
+    if(b == nmeta){
+      de = (struct dirent*)bp->data;
+      de->inum = ROOTINO;
+      de->reclen = DIRENT_SIZE(1);
+      de->namelen = 1;
+      de->name[0] = '.';
+      de = (struct dirent*)(bp->data + DIRENT_SIZE(1));
+      de->inum = ROOTINO;
+      de->reclen = BSIZE - DIRENT_SIZE(1);
+      de->namelen = 2;
+      de->name[0] = de->name[1] = '.';
+    }
+    bwrite(bp);
+    brelse(bp);
+  }
+}
+
+// 把设备 dev 上的文件系统挂载到目录 path。
+// flags 含 MNT_FORMAT 时先在内存盘上建立空文件系统。
+// Returns 0 on success, -1 on error.
+int
+fsmountdev(uint dev, char *path, int flags)
+{
+  struct inode *ip, *root;
+  struct mount *m, *free;
+
+  // 没有驱动的设备号会落到别的设备上，不能挂载
+  if(dev == 0 || dev >= NBDEV || ((flags & MNT_FORMAT) && dev != RAMDEV))
+    return -1;
+  if(dev != TMPDEV && !bdevok(dev))
+    return -1;
+
+  begin_op();
+  if((ip = namei(path)) == 0){
+    end_op();
+    return -1;
+  }
+  ilock(ip);
+  // 不能挂载到某个文件系统的根目录上
+  if(ip->type != T_DIR || ip->mounted || ip->inum == ROOTINO){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+  iunlock(ip);
+  end_op();
+
+  log_freeze();
+  free = 0;
+  acquire(&mtab.lock);
+  // 上面检查 mounted 之后可能有别的 mount 挂到了同一个目录上
+  if(ip->mounted){
+    release(&mtab.lock);
+    goto bad;
+  }
+  for(m = mtab.m; m < mtab.m + NMOUNT; m++){
+    if(m->dev == dev)
+      break;
+    if(m->dev == 0 && free == 0)
+      free = m;
+  }
+  release(&mtab.lock);
+  if(m < mtab.m + NMOUNT || free == 0)
+    goto bad;
+
+  // 日志已冻结，其他进程不会同时 mount/umount，可以在锁外做 I/O
+  if(dev == TMPDEV){
+    // tmpfs 没有超级块和日志，ninodes 只用于检查 inum 的范围
+    memset(&free->sb, 0, sizeof(free->sb));
+    free->sb.ninodes = NTNODE;
+    if(tmpfs_mount() < 0)
+      goto bad;
+  } else {
+    // 内存盘的页在这里分配，之后的 I/O 不会因为内存不足失败
+    if(dev == RAMDEV && ramdiskalloc() < 0)
+      goto bad;
+    if(flags & MNT_FORMAT)
+      fsformat(dev, RAMDISKSIZE);
+    readsb(dev, &free->sb);
+    if(free->sb.magic != FSMAGIC)
+      goto bad;
+    initlog(dev, &free->sb, flags & MNT_RDONLY);
+  }
+  root = iget(dev, ROOTINO);
+
+  acquire(&mtab.lock);
+  free->flags = flags & MNT_RDONLY;
+  free->mntpt = ip;
+  free->root = root;
+  ip->mounted = 1;
+  free->dev = dev;
+  release(&mtab.lock);
+  log_thaw();
+  return 0;
+
+bad:
+  log_thaw();
+  begin_op();
+  iput(ip);
+  end_op();
+  return -1;
+}
+
+// 卸载挂载在 path 上的文件系统。该文件系统中还有 inode
+// 被引用（打开的文件、当前目录）时失败。
+// Returns 0 on success, -1 on error.
+int
+fsumount(char *path)
+{
+  struct inode *ip, *mp, *p;
+  struct mount *m;
+  uint dev;
+  int busy;
+
+  begin_op();
+  ip = namei(path);
+  end_op();
+  if(ip == 0)
+    return -1;
+
+  log_freeze();
+  acquire(&mtab.lock);
+  for(m = mtab.m; m < mtab.m + NMOUNT; m++){
+    if(m->dev && m->root == ip && m->mntpt)
+      break;
+  }
+  if(m == mtab.m + NMOUNT){
+    release(&mtab.lock);
+    goto bad;
+  }
+  // 除了挂载表和 namei 各持有根目录的一个引用外，不能有别的引用
+  busy = 0;
+  acquire(&icache.lock);
+  for(p = &icache.inode[0]; p < &icache.inode[NINODE]; p++){
+    if(p->dev == m->dev && p->ref > (p == ip ? 2 : 0))
+      busy = 1;
+  }
+  release(&icache.lock);
+  if(busy){
+    release(&mtab.lock);
+    goto bad;
+  }
+  // 表项先不释放，mntpt 为 0 后路径解析不会再进入这个文件系统，
+  // 清理完之前同一设备也不能重新挂载
+  mp = m->mntpt;
+  mp->mounted = 0;
+  m->mntpt = 0;
+  m->root = 0;
+  dev = m->dev;
+  release(&mtab.lock);
+  freelog(dev);
+  log_thaw();
+
+  // 根目录还有链接，iput 不会写盘
+  begin_op();
+  iput(ip);
+  iput(ip);
+  iput(mp);
+  end_op();
+
+  // 让该设备在 icache 中的 inode 失效，重新挂载时重新读入
+  acquire(&icache.lock);
+  for(p = &icache.inode[0]; p < &icache.inode[NINODE]; p++){
+    if(p->dev == dev && p->ref == 0)
+      p->valid = 0;
+  }
+  release(&icache.lock);
+  dcache_purge(dev);
+  if(dev == TMPDEV)
+    tmpfs_unmount();
+
+  acquire(&mtab.lock);
+  m->dev = 0;
+  release(&mtab.lock);
+  return 0;
+
+bad:
+  log_thaw();
+  begin_op();
+  iput(ip);
+  end_op();
+  return -1;
+}
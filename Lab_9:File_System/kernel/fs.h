@@ -7,7 +7,7 @@
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
-//                                          free bit map | data blocks]
+//                          free bit map | block refcounts | data blocks]
 //
 // mkfs computes the super block and builds an initial file system. The
 // super block describes the disk layout:
@@ -20,6 +20,7 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint refstart;     // Block number of first block refcount block (0: none)
 };
 
 #define FSMAGIC 0x10203040
@@ -33,14 +34,29 @@ struct superblock {
 // On-disk inode structure
 struct dinode {
   short type;           // File type
-  short major;          // Major device number (T_DEVICE only)
-  short minor;          // Minor device number (T_DEVICE only)
+  char major;           // Major device number (T_DEVICE only)
+  char minor;           // Minor device number (T_DEVICE only)
+  ushort flags;         // DI_* flags
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
   // NDIRECT已被修改，故addrs数组也需要修改，file.h中inode结构的addrs也需要修改
   uint addrs[NDIRECT+2];   // Data block addresses 
 };
 
+// dinode.flags
+#define DI_COMPRESS 0x1 // 数据按簇压缩存放
+
+// 压缩文件以簇为单位存放，每 ZCLUSTER 个逻辑块为一簇。
+// 若簇内已分配的块数少于按文件大小需要的块数，该簇是压缩的：
+// 前几个块依次存放 struct zhdr 和压缩数据，其余槽位为 0；
+// 否则各块按原样存放。文件除末尾外没有空洞，所以这个判断是确定的。
+#define ZCLUSTER 4
+
+struct zhdr {
+  ushort zlen;          // 压缩数据的字节数
+  ushort rawlen;        // 解压后的字节数
+};
+
 // Inodes per block.
 #define IPB           (BSIZE / sizeof(struct dinode))
 
@@ -53,11 +69,45 @@ struct dinode {
 // Block of free map containing bit for block b
 #define BBLOCK(b, sb) ((b)/BPB + sb.bmapstart)
 
-// Directory is a file containing a sequence of dirent structures.
-#define DIRSIZ 14
+// 块引用计数：reflink 共享的块除位图中的一位外，还记录额外的引用数。
+// 0 表示只有一个引用者，所以全 0 的表与没有共享的文件系统一致。
+// 间接块的计数是指向它的父指针个数，它下面的块只被它引用一次。
+#define RPB           (BSIZE / sizeof(ushort))
+
+// Block of refcount table containing the count for block b
+#define RBLOCK(b, sb) ((b)/RPB + sb.refstart)
+
+// Directory is a file containing a sequence of variable-length
+// entries. Each starts with a struct dirent followed by namelen
+// bytes of name (not NUL-terminated), padded to 4 bytes. reclen is
+// the distance to the next entry; entries never cross a block
+// boundary, and the last entry in a block extends to its end.
+// An entry with inum 0 is free space.
+#define DIRSIZ 255    // maximum name length
 
 struct dirent {
-  ushort inum;
-  char name[DIRSIZ];
+  uint inum;
+  ushort reclen;        // bytes from this entry to the next
+  uchar namelen;
+  uchar pad;
+  char name[];
 };
 
+// Bytes needed by an entry with a name of n bytes.
+#define DIRENT_SIZE(n) ((sizeof(struct dirent) + (n) + 3) & ~3)
+
+// getdents 返回的记录，name 以 NUL 结尾，reclen 为到下一条记录的字节数。
+// 带 GD_STAT 调用时 type 和 size 取自 inode，否则为 0。
+struct gdent {
+  uint inum;
+  uint size;
+  ushort reclen;
+  uchar namelen;
+  uchar type;
+  char name[];
+};
+
+#define GD_STAT 0x1
+
+#define GDENT_SIZE(n) ((sizeof(struct gdent) + (n) + 1 + 3) & ~3)
+
@@ -0,0 +1,333 @@
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+
+// Simple logging that allows concurrent FS system calls.
+//
+// A log transaction contains the updates of multiple FS system
+// calls. The logging system only commits when there are
+// no FS system calls active. Thus there is never
+// any reasoning required about whether a commit might
+// write an uncommitted system call's updates to disk.
+//
+// A system call should call begin_op()/end_op() to mark
+// its start and end. Usually begin_op() just increments
+// the count of in-progress FS system calls and returns.
+// But if it thinks the log is close to running out, it
+// sleeps until the last outstanding end_op() commits.
+//
+// The log is a physical re-do log containing disk blocks.
+// The on-disk log format:
+//   header block, containing block #s for block A, B, C, ...
+//   block A
+//   block B
+//   block C
+//   ...
+// Log appends are synchronous.
+//
+// 每个挂载的可写文件系统有自己的日志，提交互不影响。
+// begin_op() 不知道系统调用会写哪个设备，所以在每个日志中都预留空间，
+// end_op() 再逐个结束；log_write() 按块所在的设备记入对应的日志。
+// 只读挂载的文件系统没有日志。
+
+// Contents of the header block, used for both the on-disk header block
+// and to keep track in memory of logged blocks before commit.
+struct logheader {
+  int n;
+  int block[LOGSIZE];
+};
+
+struct log {
+  struct spinlock lock;
+  int start;
+  int size;
+  int outstanding; // how many FS sys calls are executing.
+  int committing;  // in commit(), please wait.
+  int dev;         // 0 表示空闲
+  struct logheader lh;
+};
+
+struct {
+  struct spinlock lock;
+  int nops;        // 进行中的文件系统操作数
+  int frozen;      // mount/umount 正在增删日志
+  struct log log[NMOUNT];
+} logs;
+
+static void recover_from_log(struct log*);
+static void commit(struct log*);
+
+void
+loginit(void)
+{
+  initlock(&logs.lock, "logs");
+  for(int i = 0; i < NMOUNT; i++)
+    initlock(&logs.log[i].lock, "log");
+}
+
+// 为 dev 建立日志并恢复已提交的事务。只读挂载时不建立日志，
+// 也不回放，要求镜像是干净的。
+// 在启动时或 log_freeze() 之后调用。
+void
+initlog(int dev, struct superblock *sb, int readonly)
+{
+  struct log *l;
+
+  if (sizeof(struct logheader) >= BSIZE)
+    panic("initlog: too big logheader");
+  if(readonly)
+    return;
+
+  for(l = logs.log; l < logs.log + NMOUNT; l++){
+    if(l->dev == 0)
+      break;
+  }
+  if(l == logs.log + NMOUNT)
+    panic("initlog: no log");
+  l->dev = dev;
+  l->start = sb->logstart;
+  l->size = sb->nlog;
+  recover_from_log(l);
+}
+
+// 释放 dev 的日志。在 log_freeze() 之后调用，此时所有事务都已提交。
+void
+freelog(int dev)
+{
+  for(struct log *l = logs.log; l < logs.log + NMOUNT; l++){
+    if(l->dev == dev)
+      l->dev = 0;
+  }
+}
+
+// 等待进行中的文件系统操作全部结束，并阻止新的操作开始。
+void
+log_freeze(void)
+{
+  acquire(&logs.lock);
+  while(logs.frozen || logs.nops > 0)
+    sleep(&logs, &logs.lock);
+  logs.frozen = 1;
+  release(&logs.lock);
+}
+
+void
+log_thaw(void)
+{
+  acquire(&logs.lock);
+  logs.frozen = 0;
+  wakeup(&logs);
+  release(&logs.lock);
+}
+
+// Copy committed blocks from log to their home location
+static void
+install_trans(struct log *l, int recovering)
+{
+  int tail;
+
+  for (tail = 0; tail < l->lh.n; tail++) {
+    struct buf *lbuf = bread(l->dev, l->start+tail+1); // read log block
+    struct buf *dbuf = bread(l->dev, l->lh.block[tail]); // read dst
+    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+    bwrite(dbuf);  // write dst to disk
+    if(recovering == 0)
+      bunpin(dbuf);
+    brelse(lbuf);
+    brelse(dbuf);
+  }
+}
+
+// Read the log header from disk into the in-memory log header
+static void
+read_head(struct log *l)
+{
+  struct buf *buf = bread(l->dev, l->start);
+  struct logheader *lh = (struct logheader *) (buf->data);
+  int i;
+  l->lh.n = lh->n;
+  for (i = 0; i < l->lh.n; i++) {
+    l->lh.block[i] = lh->block[i];
+  }
+  brelse(buf);
+}
+
+// Write in-memory log header to disk.
+// This is the true point at which the
+// current transaction commits.
+static void
+write_head(struct log *l)
+{
+  struct buf *buf = bread(l->dev, l->start);
+  struct logheader *hb = (struct logheader *) (buf->data);
+  int i;
+  hb->n = l->lh.n;
+  for (i = 0; i < l->lh.n; i++) {
+    hb->block[i] = l->lh.block[i];
+  }
+  bwrite(buf);
+  brelse(buf);
+}
+
+static void
+recover_from_log(struct log *l)
+{
+  read_head(l);
+  install_trans(l, 1); // if committed, copy from log to disk
+  l->lh.n = 0;
+  write_head(l); // clear the log
+}
+
+static void
+log_begin(struct log *l)
+{
+  acquire(&l->lock);
+  while(1){
+    if(l->committing){
+      sleep(l, &l->lock);
+    } else if(l->lh.n + (l->outstanding+1)*MAXOPBLOCKS > LOGSIZE){
+      // this op might exhaust log space; wait for commit.
+      sleep(l, &l->lock);
+    } else {
+      l->outstanding += 1;
+      release(&l->lock);
+      break;
+    }
+  }
+}
+
+static void
+log_end(struct log *l)
+{
+  int do_commit = 0;
+
+  acquire(&l->lock);
+  l->outstanding -= 1;
+  if(l->committing)
+    panic("log.committing");
+  if(l->outstanding == 0){
+    do_commit = 1;
+    l->committing = 1;
+  } else {
+    // begin_op() may be waiting for log space,
+    // and decrementing log.outstanding has decreased
+    // the amount of reserved space.
+    wakeup(l);
+  }
+  release(&l->lock);
+
+  if(do_commit){
+    // call commit w/o holding locks, since not allowed
+    // to sleep with locks.
+    commit(l);
+    acquire(&l->lock);
+    l->committing = 0;
+    wakeup(l);
+    release(&l->lock);
+  }
+}
+
+// called at the start of each FS system call.
+// 按固定顺序在每个日志中预留空间，所以不会互相等待成环。
+void
+begin_op(void)
+{
+  acquire(&logs.lock);
+  while(logs.frozen)
+    sleep(&logs, &logs.lock);
+  logs.nops++;
+  release(&logs.lock);
+
+  for(struct log *l = logs.log; l < logs.log + NMOUNT; l++){
+    if(l->dev)
+      log_begin(l);
+  }
+}
+
+// called at the end of each FS system call.
+// commits if this was the last outstanding operation.
+void
+end_op(void)
+{
+  for(struct log *l = logs.log; l < logs.log + NMOUNT; l++){
+    if(l->dev)
+      log_end(l);
+  }
+
+  acquire(&logs.lock);
+  if(--logs.nops == 0)
+    wakeup(&logs);
+  release(&logs.lock);
+}
+
+// Copy modified blocks from cache to log.
+static void
+write_log(struct log *l)
+{
+  int tail;
+
+  for (tail = 0; tail < l->lh.n; tail++) {
+    struct buf *to = bread(l->dev, l->start+tail+1); // log block
+    struct buf *from = bread(l->dev, l->lh.block[tail]); // cache block
+    memmove(to->data, from->data, BSIZE);
+    bwrite(to);  // write the log
+    brelse(from);
+    brelse(to);
+  }
+}
+
+static void
+commit(struct log *l)
+{
+  if (l->lh.n > 0) {
+    write_log(l);     // Write modified blocks from cache to log
+    write_head(l);    // Write header to disk -- the real commit
+    install_trans(l, 0); // Now install writes to home locations
+    l->lh.n = 0;
+    write_head(l);    // Erase the transaction from the log
+  }
+}
+
+// Caller has modified b->data and is done with the buffer.
+// Record the block number and pin in the cache by increasing refcnt.
+// commit()/write_log() will do the disk write.
+//
+// log_write() replaces bwrite(); a typical use is:
+//   bp = bread(...)
+//   modify bp->data[]
+//   log_write(bp)
+//   brelse(bp)
+void
+log_write(struct buf *b)
+{
+  struct log *l;
+  int i;
+
+  for(l = logs.log; l < logs.log + NMOUNT; l++){
+    if(l->dev == b->dev)
+      break;
+  }
+  if(l == logs.log + NMOUNT)
+    panic("log_write: no log");
+  if (l->lh.n >= LOGSIZE || l->lh.n >= l->size - 1)
+    panic("too big a transaction");
+  if (l->outstanding < 1)
+    panic("log_write outside of trans");
+
+  acquire(&l->lock);
+  for (i = 0; i < l->lh.n; i++) {
+    if (l->lh.block[i] == b->blockno)   // log absorbtion
+      break;
+  }
+  l->lh.block[i] = b->blockno;
+  if (i == l->lh.n) {  // Add new block to log?
+    bpin(b);
+    l->lh.n++;
+  }
+  release(&l->lock);
+}
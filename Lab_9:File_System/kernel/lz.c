@@ -0,0 +1,161 @@
+// LZ77 压缩，编码格式与 LZ4 的 block format 相同：
+// 每个序列为 token（高 4 位字面量长度，低 4 位匹配长度-4），
+// 长度为 15 时后接若干 255 和一个余数字节，然后是字面量、
+// 2 字节小端偏移。最后一个序列只有字面量。
+//
+// 供压缩文件（DI_COMPRESS）按簇压缩使用，输入不超过 64KB。
+// mkfs 在宿主机上直接包含本文件，此时定义了 MKFS。
+
+#ifndef MKFS
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#endif
+
+#define LZ_MINMATCH  4
+#define LZ_LASTLIT   5   // 最后 5 个字节总是作为字面量
+#define LZ_MFLIMIT   12  // 距离结尾不足 12 字节时不再开始新的匹配
+#define LZ_HASHLOG   8   // 哈希表放在栈上，保持较小
+
+static uint
+lz_read32(const uchar *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint)p[3] << 24);
+}
+
+static uint
+lz_hash(uint v)
+{
+  return (v * 2654435761U) >> (32 - LZ_HASHLOG);
+}
+
+// 写出长度的扩展字节（长度 >= 15 的部分）。
+// Returns the new output position, or -1 if dst is full.
+static int
+lz_putlen(uchar *dst, int op, int cap, int len)
+{
+  for(; len >= 255; len -= 255){
+    if(op >= cap)
+      return -1;
+    dst[op++] = 255;
+  }
+  if(op >= cap)
+    return -1;
+  dst[op++] = len;
+  return op;
+}
+
+// 写出一个序列：src[anchor, anchor+lit) 为字面量，之后是一个
+// 偏移为 off、长度为 mlen 的匹配（mlen == 0 表示最后一个序列）。
+static int
+lz_emit(const uchar *src, int anchor, int lit, int off, int mlen,
+        uchar *dst, int op, int cap)
+{
+  int token;
+
+  if(op >= cap)
+    return -1;
+  token = op++;
+  dst[token] = (lit >= 15 ? 15 : lit) << 4;
+  if(lit >= 15 && (op = lz_putlen(dst, op, cap, lit - 15)) < 0)
+    return -1;
+  if(op + lit > cap)
+    return -1;
+  memmove(dst + op, src + anchor, lit);
+  op += lit;
+
+  if(mlen == 0)
+    return op;
+  if(op + 2 > cap)
+    return -1;
+  dst[op++] = off & 0xff;
+  dst[op++] = off >> 8;
+  mlen -= LZ_MINMATCH;
+  dst[token] |= (mlen >= 15 ? 15 : mlen);
+  if(mlen >= 15 && (op = lz_putlen(dst, op, cap, mlen - 15)) < 0)
+    return -1;
+  return op;
+}
+
+// 压缩 src[0, n) 到 dst，最多写 cap 字节。
+// Returns the compressed length, or -1 if it does not fit in cap.
+int
+lz_compress(const uchar *src, int n, uchar *dst, int cap)
+{
+  ushort table[1 << LZ_HASHLOG];
+  int ip, anchor, ref, len, op;
+  uint h;
+
+  memset(table, 0, sizeof(table));
+  ip = anchor = op = 0;
+  while(ip < n - LZ_MFLIMIT){
+    h = lz_hash(lz_read32(src + ip));
+    ref = table[h];
+    table[h] = ip;
+    if(ref >= ip || ip - ref > 0xffff || lz_read32(src + ref) != lz_read32(src + ip)){
+      ip++;
+      continue;
+    }
+    len = LZ_MINMATCH;
+    while(ip + len < n - LZ_LASTLIT && src[ref + len] == src[ip + len])
+      len++;
+    if((op = lz_emit(src, anchor, ip - anchor, ip - ref, len, dst, op, cap)) < 0)
+      return -1;
+    ip += len;
+    anchor = ip;
+  }
+  return lz_emit(src, anchor, n - anchor, 0, 0, dst, op, cap);
+}
+
+// 解压 src[0, n) 到 dst，最多写 cap 字节。
+// Returns the decompressed length, or -1 if the input is corrupt.
+int
+lz_decompress(const uchar *src, int n, uchar *dst, int cap)
+{
+  int ip, op, token, len, off, b;
+
+  ip = op = 0;
+  while(ip < n){
+    token = src[ip++];
+
+    len = token >> 4;
+    if(len == 15){
+      do {
+        if(ip >= n)
+          return -1;
+        b = src[ip++];
+        len += b;
+      } while(b == 255);
+    }
+    if(ip + len > n || op + len > cap)
+      return -1;
+    memmove(dst + op, src + ip, len);
+    ip += len;
+    op += len;
+    if(ip >= n)
+      break;      // 最后一个序列没有匹配部分
+
+    if(ip + 2 > n)
+      return -1;
+    off = src[ip] | (src[ip+1] << 8);
+    ip += 2;
+    if(off == 0 || off > op)
+      return -1;
+    len = token & 15;
+    if(len == 15){
+      do {
+        if(ip >= n)
+          return -1;
+        b = src[ip++];
+        len += b;
+      } while(b == 255);
+    }
+    len += LZ_MINMATCH;
+    if(op + len > cap)
+      return -1;
+    // 匹配可能与输出重叠（off < len），只能逐字节复制
+    for(; len > 0; len--, op++)
+      dst[op] = dst[op - off];
+  }
+  return op;
+}
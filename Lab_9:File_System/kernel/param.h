@@ -0,0 +1,10 @@
+// 这里仅列出新增的定义，其余与原版 param.h 相同
+
+#define ROOTFLAGS    0  // 根文件系统的挂载标志，不可变镜像可设为 MNT_RDONLY
+#define NMOUNT       4  // 同时挂载的文件系统数
+#define NBDEV        4  // 块设备号上限，见 bio.c 的设备开关
+#define RAMDEV       2  // 内存盘的设备号
+#define RAMDISKSIZE  2048  // 内存盘的块数
+#define TMPDEV       3  // tmpfs 的设备号
+#define NTNODE       1000  // tmpfs 的 inode 数
+#define NFDCHUNK     32  // 每个进程最多 NFDCHUNK*FDCHUNK 个文件描述符，取代 NOFILE
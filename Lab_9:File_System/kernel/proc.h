@@ -0,0 +1,27 @@
+// 这里仅列出修改的部分，其余与原版 proc.h 相同
+
+struct fdchunk;
+
+// Per-process state
+struct proc {
+  struct spinlock lock;
+
+  // p->lock must be held when using these:
+  enum procstate state;        // Process state
+  struct proc *parent;         // Parent process
+  void *chan;                  // If non-zero, sleeping on chan
+  int killed;                  // If non-zero, have been killed
+  int xstate;                  // Exit status to be returned to parent's wait
+  int pid;                     // Process ID
+
+  // these are private to the process, so p->lock need not be held.
+  uint64 kstack;               // Virtual address of kernel stack
+  uint64 sz;                   // Size of process memory (bytes)
+  pagetable_t pagetable;       // User page table
+  struct trapframe *trapframe; // data page for trampoline.S
+  struct context context;      // swtch() here to run process
+  uint64 fdfull;               // 第 i 位表示 fdchunk[i] 已满
+  struct fdchunk *fdchunk[NFDCHUNK]; // Open files，取代 ofile[NOFILE]
+  struct inode *cwd;           // Current directory
+  char name[16];               // Process name (debugging)
+};
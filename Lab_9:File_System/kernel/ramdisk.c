@@ -0,0 +1,80 @@
+// 内存盘：RAMDEV 上的 RAMDISKSIZE 个块存放在 kalloc 的页中，
+// 每页 PGSIZE/BSIZE 块。页在挂载时由 ramdiskalloc 一次分配好，
+// 之后的读写不会因为内存不足而失败；没写过的块读出来是 0。
+// 通过 bio.c 的设备开关接入 buffer cache，可以用 mount 的
+// MNT_FORMAT 在上面建立文件系统。
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "defs.h"
+#include "fs.h"
+#include "buf.h"
+
+#define BPP (PGSIZE / BSIZE)   // 每页的块数
+
+struct {
+  struct spinlock lock;
+  char *pages[RAMDISKSIZE / BPP];
+} ramdisk;
+
+static void
+ramdisk_rw(struct buf *b, int write)
+{
+  char *page, *p;
+
+  if(b->blockno >= RAMDISKSIZE)
+    panic("ramdisk_rw: blockno");
+
+  acquire(&ramdisk.lock);
+  page = ramdisk.pages[b->blockno / BPP];
+  release(&ramdisk.lock);
+
+  // 页一旦分配就不再释放，块的内容由 b->lock 保护
+  if(page == 0){
+    // 还没有挂载过：读出 0，不应该有写入
+    if(write)
+      panic("ramdisk_rw: not allocated");
+    memset(b->data, 0, BSIZE);
+    return;
+  }
+  p = page + (b->blockno % BPP) * BSIZE;
+  if(write)
+    memmove(p, b->data, BSIZE);
+  else
+    memmove(b->data, p, BSIZE);
+}
+
+// 分配内存盘还没有的页，由 mount 在读写内存盘之前调用。
+// 已经分配的页保留，卸载后再挂载时内容不变。
+// Returns 0 on success, -1 if out of memory.
+int
+ramdiskalloc(void)
+{
+  char *page;
+  int i, r;
+
+  r = 0;
+  acquire(&ramdisk.lock);
+  for(i = 0; i < RAMDISKSIZE / BPP; i++){
+    if(ramdisk.pages[i] != 0)
+      continue;
+    if((page = kalloc()) == 0){
+      r = -1;
+      break;
+    }
+    memset(page, 0, PGSIZE);
+    ramdisk.pages[i] = page;
+  }
+  release(&ramdisk.lock);
+  return r;
+}
+
+void
+ramdiskinit(void)
+{
+  initlock(&ramdisk.lock, "ramdisk");
+  bdevregister(RAMDEV, ramdisk_rw);
+}
@@ -0,0 +1,78 @@
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "syscall.h"
+#include "defs.h"
+
+// 这里仅列出修改的部分，其余与原版 syscall.c 相同
+
+extern uint64 sys_chdir(void);
+extern uint64 sys_close(void);
+extern uint64 sys_dup(void);
+extern uint64 sys_exec(void);
+extern uint64 sys_exit(void);
+extern uint64 sys_fork(void);
+extern uint64 sys_fstat(void);
+extern uint64 sys_getpid(void);
+extern uint64 sys_kill(void);
+extern uint64 sys_link(void);
+extern uint64 sys_mkdir(void);
+extern uint64 sys_mknod(void);
+extern uint64 sys_open(void);
+extern uint64 sys_pipe(void);
+extern uint64 sys_read(void);
+extern uint64 sys_sbrk(void);
+extern uint64 sys_sleep(void);
+extern uint64 sys_unlink(void);
+extern uint64 sys_wait(void);
+extern uint64 sys_write(void);
+extern uint64 sys_uptime(void);
+extern uint64 sys_symlink(void);
+extern uint64 sys_fadvise(void);
+extern uint64 sys_reflink(void);
+extern uint64 sys_getdents(void);
+extern uint64 sys_openat(void);
+extern uint64 sys_mkdirat(void);
+extern uint64 sys_unlinkat(void);
+extern uint64 sys_fstatat(void);
+extern uint64 sys_symlinkat(void);
+extern uint64 sys_mount(void);
+extern uint64 sys_umount(void);
+
+static uint64 (*syscalls[])(void) = {
+[SYS_fork]    sys_fork,
+[SYS_exit]    sys_exit,
+[SYS_wait]    sys_wait,
+[SYS_pipe]    sys_pipe,
+[SYS_read]    sys_read,
+[SYS_kill]    sys_kill,
+[SYS_exec]    sys_exec,
+[SYS_fstat]   sys_fstat,
+[SYS_chdir]   sys_chdir,
+[SYS_dup]     sys_dup,
+[SYS_getpid]  sys_getpid,
+[SYS_sbrk]    sys_sbrk,
+[SYS_sleep]   sys_sleep,
+[SYS_uptime]  sys_uptime,
+[SYS_open]    sys_open,
+[SYS_write]   sys_write,
+[SYS_mknod]   sys_mknod,
+[SYS_unlink]  sys_unlink,
+[SYS_link]    sys_link,
+[SYS_mkdir]   sys_mkdir,
+[SYS_close]   sys_close,
+[SYS_symlink] sys_symlink,
+[SYS_fadvise] sys_fadvise,
+[SYS_reflink] sys_reflink,
+[SYS_getdents] sys_getdents,
+[SYS_openat]  sys_openat,
+[SYS_mkdirat] sys_mkdirat,
+[SYS_unlinkat] sys_unlinkat,
+[SYS_fstatat] sys_fstatat,
+[SYS_symlinkat] sys_symlinkat,
+[SYS_mount]   sys_mount,
+[SYS_umount]  sys_umount,
+};
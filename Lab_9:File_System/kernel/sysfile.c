@@ -0,0 +1,716 @@
+//
+// File-system system calls.
+// Mostly argument checking, since we don't trust
+// user code, and calls into file.c and fs.c.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "stat.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "fcntl.h"
+
+// 这里仅列出修改和新增的函数
+// 目录项变长后，名字缓冲区都要容纳 DIRSIZ+1 个字节
+
+// Fetch the nth word-sized system call argument as a file descriptor
+// and return both the descriptor and the corresponding struct file.
+static int
+argfd(int n, int *pfd, struct file **pf)
+{
+  int fd;
+  struct file *f;
+
+  if(argint(n, &fd) < 0)
+    return -1;
+  if((f = fdget(fd)) == 0)
+    return -1;
+  if(pfd)
+    *pfd = fd;
+  if(pf)
+    *pf = f;
+  return 0;
+}
+
+// fdalloc 移到 file.c，描述符表按需增长
+
+uint64
+sys_close(void)
+{
+  int fd;
+  struct file *f;
+
+  if(argfd(0, &fd, &f) < 0)
+    return -1;
+  fdfree(fd);
+  fileclose(f);
+  return 0;
+}
+
+uint64
+sys_pipe(void)
+{
+  uint64 fdarray; // user pointer to array of two integers
+  struct file *rf, *wf;
+  int fd0, fd1;
+  struct proc *p = myproc();
+
+  if(argaddr(0, &fdarray) < 0)
+    return -1;
+  if(pipealloc(&rf, &wf) < 0)
+    return -1;
+  fd0 = -1;
+  if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
+    if(fd0 >= 0)
+      fdfree(fd0);
+    fileclose(rf);
+    fileclose(wf);
+    return -1;
+  }
+  if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
+     copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
+    fdfree(fd0);
+    fdfree(fd1);
+    fileclose(rf);
+    fileclose(wf);
+    return -1;
+  }
+  return 0;
+}
+
+// Create the path new as a link to the same inode as old.
+uint64
+sys_link(void)
+{
+  char name[DIRSIZ+1], new[MAXPATH], old[MAXPATH];
+  struct inode *dp, *ip;
+
+  if(argstr(0, old, MAXPATH) < 0 || argstr(1, new, MAXPATH) < 0)
+    return -1;
+
+  begin_op();
+  if((ip = namei(old)) == 0){
+    end_op();
+    return -1;
+  }
+
+  ilock(ip);
+  if(ip->type == T_DIR || fsrdonly(ip->dev)){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+
+  ip->nlink++;
+  iupdate(ip);
+  iunlock(ip);
+
+  if((dp = nameiparent(new, name)) == 0)
+    goto bad;
+  ilock(dp);
+  if(dp->dev != ip->dev || dirlink(dp, name, ip->inum) < 0){
+    iunlockput(dp);
+    goto bad;
+  }
+  iunlockput(dp);
+  iput(ip);
+
+  end_op();
+
+  return 0;
+
+bad:
+  ilock(ip);
+  ip->nlink--;
+  iupdate(ip);
+  iunlockput(ip);
+  end_op();
+  return -1;
+}
+
+// Is the directory dp empty except for "." and ".." ?
+static int
+isdirempty(struct inode *dp)
+{
+  uint off;
+  struct dirent de;
+  char name[2];
+
+  for(off = 0; off < dp->size; off += de.reclen){
+    // 读不出来或已损坏的目录当作非空，不允许删除
+    if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+      return 0;
+    if(de.reclen == 0)
+      return 0;
+    if(de.inum == 0)
+      continue;
+    if(de.namelen > 2)
+      return 0;
+    if(readi(dp, 0, (uint64)name, off + sizeof(de), de.namelen) != de.namelen)
+      return 0;
+    if(name[0] != '.' || (de.namelen == 2 && name[1] != '.'))
+      return 0;
+  }
+  return 1;
+}
+
+// 取第 n 个参数为 *at 系统调用的目录 fd。
+// AT_FDCWD 表示当前目录，此时 *dpp 为 0。
+static int
+argdirfd(int n, struct inode **dpp)
+{
+  int fd;
+  struct file *f;
+
+  if(argint(n, &fd) < 0)
+    return -1;
+  if(fd == AT_FDCWD){
+    *dpp = 0;
+    return 0;
+  }
+  if(argfd(n, 0, &f) < 0 || f->type != FD_INODE)
+    return -1;
+  *dpp = f->ip;
+  return 0;
+}
+
+// 删除 path，相对路径从 start 开始解析
+static int
+unlinkat(struct inode *start, char *path)
+{
+  struct inode *ip, *dp;
+  char name[DIRSIZ+1];
+  uint off;
+
+  begin_op();
+  if((dp = nameiparentat(start, path, name)) == 0){
+    end_op();
+    return -1;
+  }
+  if(fsrdonly(dp->dev)){
+    iput(dp);
+    end_op();
+    return -1;
+  }
+
+  ilock(dp);
+
+  // Cannot unlink "." or "..".
+  if(namecmp(name, ".") == 0 || namecmp(name, "..") == 0)
+    goto bad;
+
+  if((ip = dirlookup(dp, name, &off)) == 0)
+    goto bad;
+  ilock(ip);
+
+  if(ip->nlink < 1)
+    panic("unlink: nlink < 1");
+  if(ip->type == T_DIR && !isdirempty(ip)){
+    iunlockput(ip);
+    goto bad;
+  }
+
+  if(dirunlink(dp, off) < 0){
+    iunlockput(ip);
+    goto bad;
+  }
+  if(ip->type == T_DIR){
+    dp->nlink--;
+    iupdate(dp);
+  }
+  iunlockput(dp);
+
+  ip->nlink--;
+  iupdate(ip);
+  iunlockput(ip);
+
+  end_op();
+
+  return 0;
+
+bad:
+  iunlockput(dp);
+  end_op();
+  return -1;
+}
+
+uint64
+sys_unlink(void)
+{
+  char path[MAXPATH];
+
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
+  return unlinkat(0, path);
+}
+
+// unlinkat(dirfd, path)
+uint64
+sys_unlinkat(void)
+{
+  char path[MAXPATH];
+  struct inode *dp;
+
+  if(argdirfd(0, &dp) < 0 || argstr(1, path, MAXPATH) < 0)
+    return -1;
+  return unlinkat(dp, path);
+}
+
+static struct inode*
+createat(struct inode *start, char *path, short type, short major, short minor)
+{
+  struct inode *ip, *dp;
+  char name[DIRSIZ+1];
+
+  if((dp = nameiparentat(start, path, name)) == 0)
+    return 0;
+  if(fsrdonly(dp->dev)){
+    iput(dp);
+    return 0;
+  }
+
+  ilock(dp);
+
+  if((ip = dirlookup(dp, name, 0)) != 0){
+    iunlockput(dp);
+    ilock(ip);
+    if(type == T_FILE && (ip->type == T_FILE || ip->type == T_DEVICE))
+      return ip;
+    iunlockput(ip);
+    return 0;
+  }
+
+  // tmpfs 的 inode 可能用完
+  if((ip = ialloc(dp->dev, type)) == 0){
+    iunlockput(dp);
+    return 0;
+  }
+
+  ilock(ip);
+  ip->major = major;
+  ip->minor = minor;
+  ip->nlink = 1;
+  iupdate(ip);
+
+  if(type == T_DIR){  // Create . and .. entries.
+    dp->nlink++;  // for ".."
+    iupdate(dp);
+    // No ip->nlink++ for ".": avoid cyclic ref count.
+    if(dirlink(ip, ".", ip->inum) < 0 || dirlink(ip, "..", dp->inum) < 0)
+      goto bad;
+  }
+
+  if(dirlink(dp, name, ip->inum) < 0)
+    goto bad;
+
+  iunlockput(dp);
+
+  return ip;
+
+bad:
+  // 磁盘文件系统上 dirlink 不会失败；tmpfs 可能分不到目录页，
+  // 撤销已做的修改，iput 会释放 ip
+  if(dp->dev != TMPDEV)
+    panic("create: dirlink");
+  if(type == T_DIR){
+    dp->nlink--;
+    iupdate(dp);
+  }
+  ip->nlink = 0;
+  iupdate(ip);
+  iunlockput(ip);
+  iunlockput(dp);
+  return 0;
+}
+
+static struct inode*
+create(char *path, short type, short major, short minor)
+{
+  return createat(0, path, type, major, minor);
+}
+
+uint64
+sys_mkdir(void)
+{
+  char path[MAXPATH];
+  struct inode *ip;
+
+  begin_op();
+  if(argstr(0, path, MAXPATH) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
+    end_op();
+    return -1;
+  }
+  iunlockput(ip);
+  end_op();
+  return 0;
+}
+
+// mkdirat(dirfd, path)
+uint64
+sys_mkdirat(void)
+{
+  char path[MAXPATH];
+  struct inode *dp, *ip;
+
+  if(argdirfd(0, &dp) < 0 || argstr(1, path, MAXPATH) < 0)
+    return -1;
+  begin_op();
+  if((ip = createat(dp, path, T_DIR, 0, 0)) == 0){
+    end_op();
+    return -1;
+  }
+  iunlockput(ip);
+  end_op();
+  return 0;
+}
+
+// 在 start 下创建指向 old 的符号链接 new
+static int
+symlinkat(char *old, struct inode *start, char *new)
+{
+  char name[DIRSIZ+1];
+  struct inode *ip=0, *dp=0;
+  int len=0;
+
+  begin_op();
+  // 解析新路径父目录
+  if((dp = nameiparentat(start, new, name)) == 0)
+    goto bad;
+  if(fsrdonly(dp->dev)){
+    iput(dp);
+    dp = 0;
+    goto bad;
+  }
+  // 创建inode
+  ilock(dp);
+  ip = ialloc(dp->dev, T_SYMLINK);
+  if (ip == 0) {
+    goto bad;
+  }
+  ilock(ip);
+  ip->nlink = 1;
+  // 将old路径写入inode的data中
+  len = strlen(old) + 1;
+  writei(ip, 0, (uint64)old, 0, len);
+  ip->size = len;
+  iupdate(ip);
+  // 创建目录项
+  if(dirlink(dp, name, ip->inum) < 0){
+    goto bad;
+  }
+
+  iunlockput(ip);
+  iunlockput(dp);
+  
+  end_op();
+  return 0;
+
+bad:
+  if (ip) {
+    ip->nlink = 0;  // 标记为未使用（可选）
+    iupdate(ip);
+    iunlockput(ip);
+  }
+  if (dp)
+    iunlockput(dp);
+  end_op();
+  return -1;
+}
+
+uint64
+sys_symlink(void)
+{
+  char new[MAXPATH], old[MAXPATH];
+
+  if (argstr(0, old, MAXPATH) < 0 || argstr(1, new, MAXPATH) < 0) {
+    return -1;
+  }
+  return symlinkat(old, 0, new);
+}
+
+// symlinkat(target, dirfd, linkpath)
+uint64
+sys_symlinkat(void)
+{
+  char new[MAXPATH], old[MAXPATH];
+  struct inode *dp;
+
+  if (argstr(0, old, MAXPATH) < 0 || argdirfd(1, &dp) < 0 ||
+      argstr(2, new, MAXPATH) < 0) {
+    return -1;
+  }
+  return symlinkat(old, dp, new);
+}
+
+#define MAX_SYMLINK_DEPTH 10
+static struct inode*
+openat_follow(struct inode *start, char *path, int flags, int depth) {
+  if (depth > MAX_SYMLINK_DEPTH) {
+    return 0; // 表示循环过深
+  }
+
+  struct inode *ip = nameiat(start, path); // 基础路径查找
+  if (ip == 0) 
+    return 0;
+  ilock(ip);
+  // 如果是符号链接且没有O_NOFOLLOW
+  if (ip->type == T_SYMLINK && (flags & O_NOFOLLOW) == 0) {
+    // 读取符号链接内容（target 路径）
+    char target[MAXPATH];
+    int n = readi(ip, 0, (uint64)target, 0, MAXPATH);
+    iunlockput(ip);
+    if (n <= 0)
+      return 0;
+
+    // 递归解析 target
+    return openat_follow(start, target, flags, depth + 1);
+  }
+  iunlock(ip);
+  return ip; // 普通文件或 O_NOFOLLOW
+}
+
+// 打开 path，相对路径从 start 开始解析
+static int
+openat(struct inode *start, char *path, int omode)
+{
+  int fd;
+  struct file *f;
+  struct inode *ip;
+
+  begin_op();
+
+  if(omode & O_CREATE){
+    ip = createat(start, path, T_FILE, 0, 0);
+    if(ip == 0){
+      end_op();
+      return -1;
+    }
+    // 只有空文件才能切换为压缩格式
+    if((omode & O_COMPRESS) && ip->size == 0 && !(ip->flags & DI_COMPRESS) && ip->dev != TMPDEV){
+      itrunc(ip);
+      ip->flags |= DI_COMPRESS;
+      iupdate(ip);
+    }
+  } else {
+    if((ip = openat_follow(start, path, omode, 0)) == 0){
+      end_op();
+      return -1;
+    }
+    ilock(ip);
+    if(ip->type == T_DIR && omode != O_RDONLY){
+      iunlockput(ip);
+      end_op();
+      return -1;
+    }
+    // 只读文件系统上的设备文件仍可写
+    if(ip->type != T_DEVICE && fsrdonly(ip->dev) &&
+       (omode & (O_WRONLY|O_RDWR|O_TRUNC))){
+      iunlockput(ip);
+      end_op();
+      return -1;
+    }
+  }
+
+  if(ip->type == T_DEVICE && (ip->major < 0 || ip->major >= NDEV)){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+
+  if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){
+    if(f)
+      fileclose(f);
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+
+  if(ip->type == T_DEVICE){
+    f->type = FD_DEVICE;
+    f->major = ip->major;
+  } else {
+    f->type = FD_INODE;
+    f->off = 0;
+  }
+  f->ip = ip;
+  f->readable = !(omode & O_WRONLY);
+  f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  // 只有未压缩的普通文件的数据块可以绕过 buffer cache
+  f->direct = (omode & O_DIRECT) && ip->type == T_FILE && !(ip->flags & DI_COMPRESS) && ip->dev != TMPDEV;
+
+  if((omode & O_TRUNC) && ip->type == T_FILE){
+    itrunc(ip);
+  }
+
+  iunlock(ip);
+  end_op();
+
+  return fd;
+}
+
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return openat(0, path, omode);
+}
+
+// openat(dirfd, path, omode)
+uint64
+sys_openat(void)
+{
+  char path[MAXPATH];
+  int omode;
+  struct inode *dp;
+
+  if(argdirfd(0, &dp) < 0 || argstr(1, path, MAXPATH) < 0 || argint(2, &omode) < 0)
+    return -1;
+  return openat(dp, path, omode);
+}
+
+// fstatat(dirfd, path, st, flags)：flags 含 O_NOFOLLOW 时不跟随符号链接
+uint64
+sys_fstatat(void)
+{
+  char path[MAXPATH];
+  struct inode *dp, *ip;
+  struct stat st;
+  uint64 p;
+  int flags;
+
+  if(argdirfd(0, &dp) < 0 || argstr(1, path, MAXPATH) < 0 || argaddr(2, &p) < 0 ||
+     argint(3, &flags) < 0)
+    return -1;
+
+  begin_op();
+  if((ip = openat_follow(dp, path, flags & O_NOFOLLOW, 0)) == 0){
+    end_op();
+    return -1;
+  }
+  ilock(ip);
+  stati(ip, &st);
+  iunlockput(ip);
+  end_op();
+
+  if(copyout(myproc()->pagetable, p, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+// fadvise(fd, off, len, advice)
+uint64
+sys_fadvise(void)
+{
+  struct file *f;
+  int off, len, advice, r;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 || argint(2, &len) < 0 ||
+     argint(3, &advice) < 0)
+    return -1;
+  if(f->type != FD_INODE || off < 0 || len < 0)
+    return -1;
+
+  ilock(f->ip);
+  r = ifadvise(f->ip, off, len, advice);
+  iunlock(f->ip);
+  return r;
+}
+
+// reflink(srcfd, dstfd)：dst 必须是以可写方式打开的空普通文件，
+// 完成后两者共享数据块，写入时再复制。
+uint64
+sys_reflink(void)
+{
+  struct file *src, *dst;
+  struct inode *a, *b;
+  int r;
+
+  if(argfd(0, 0, &src) < 0 || argfd(1, 0, &dst) < 0)
+    return -1;
+  if(src->type != FD_INODE || dst->type != FD_INODE)
+    return -1;
+  if(!src->readable || !dst->writable || src->ip == dst->ip)
+    return -1;
+
+  // 按 inum 顺序加锁，避免方向相反的两个 reflink 互相等待
+  a = src->ip;
+  b = dst->ip;
+  if(a->inum > b->inum){
+    a = dst->ip;
+    b = src->ip;
+  }
+
+  begin_op();
+  ilock(a);
+  ilock(b);
+  r = ireflink(src->ip, dst->ip);
+  iunlock(b);
+  iunlock(a);
+  end_op();
+  return r;
+}
+
+// getdents(fd, buf, n, flags)：一次返回多条 struct gdent 记录，
+// 每次最多一页。flags 含 GD_STAT 时带上类型和大小，省去逐项 stat。
+uint64
+sys_getdents(void)
+{
+  struct file *f;
+  uint64 p;
+  int n, flags, r;
+  char *buf;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0 ||
+     argint(3, &flags) < 0)
+    return -1;
+  if(f->type != FD_INODE || !f->readable || n < 0)
+    return -1;
+  if(n > PGSIZE)
+    n = PGSIZE;
+  if((buf = kalloc()) == 0)
+    return -1;
+
+  ilock(f->ip);
+  r = dirlist(f->ip, &f->off, buf, n, flags);
+  iunlock(f->ip);
+
+  if(r > 0 && copyout(myproc()->pagetable, p, buf, r) < 0)
+    r = -1;
+  kfree(buf);
+  return r;
+}
+
+// mount(dev, path, flags)：把块设备 dev 上的文件系统挂载到目录 path
+uint64
+sys_mount(void)
+{
+  char path[MAXPATH];
+  int dev, flags;
+
+  if(argint(0, &dev) < 0 || argstr(1, path, MAXPATH) < 0 || argint(2, &flags) < 0)
+    return -1;
+  if(dev < 0)
+    return -1;
+  return fsmountdev(dev, path, flags);
+}
+
+// umount(path)
+uint64
+sys_umount(void)
+{
+  char path[MAXPATH];
+
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
+  return fsumount(path);
+}
@@ -0,0 +1,279 @@
+// tmpfs：挂载在 TMPDEV 上、完全放在内存中的文件系统。
+// 不经过 bcache 和日志，也没有超级块和位图：
+// 每个 inode 对应 tmpfs.node[] 中的一项，inum 就是下标；
+// 文件数据放在 kalloc 的页中，由两级基数树按页号索引，
+// 第一次写到某页时才分配，没写过的页读出来是 0。
+// 目录项格式与磁盘文件系统相同，fs.c 中的目录操作通过
+// tmpfs_block() 直接访问数据页。
+//
+// 用 mount(TMPDEV, "/tmp", 0) 挂载，umount 时释放全部页。
+// tnode 的内容由对应 inode 的 ip->lock 保护；
+// tmpfs.lock 只保护 tnode 的分配与 getdents 读取类型和大小。
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "defs.h"
+#include "fs.h"
+#include "file.h"
+#include "stat.h"
+
+#define NPTR (PGSIZE / sizeof(void*))   // 每个索引页的指针数
+#define BPP  (PGSIZE / BSIZE)           // 每页的块数
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+struct tnode {
+  short type;      // 0 表示空闲
+  short major;
+  short minor;
+  short nlink;
+  uint size;
+  void **root;     // 基数树的根，指向 NPTR 个叶子索引页
+};
+
+struct {
+  struct spinlock lock;
+  struct tnode node[NTNODE];
+} tmpfs;
+
+static char zeropage[PGSIZE];
+
+void
+tmpfsinit(void)
+{
+  initlock(&tmpfs.lock, "tmpfs");
+}
+
+// 分配一页并清零，内存不足时返回 0
+static void*
+tzalloc(void)
+{
+  void *pa;
+
+  if((pa = kalloc()) != 0)
+    memset(pa, 0, PGSIZE);
+  return pa;
+}
+
+// 文件第 pn 页的地址。alloc 时沿途分配缺少的页；
+// 页不存在或内存不足时返回 0。Caller must hold ip->lock.
+static char*
+tpage(struct inode *ip, uint pn, int alloc)
+{
+  struct tnode *t = &tmpfs.node[ip->inum];
+  void **leaf;
+
+  if(pn / NPTR >= NPTR)
+    return 0;
+  if(t->root == 0){
+    if(!alloc || (t->root = tzalloc()) == 0)
+      return 0;
+  }
+  if((leaf = t->root[pn / NPTR]) == 0){
+    if(!alloc || (leaf = t->root[pn / NPTR] = tzalloc()) == 0)
+      return 0;
+  }
+  if(leaf[pn % NPTR] == 0){
+    if(!alloc || (leaf[pn % NPTR] = tzalloc()) == 0)
+      return 0;
+  }
+  return leaf[pn % NPTR];
+}
+
+// 文件第 bn 块的地址，供 fs.c 的目录操作使用
+char*
+tmpfs_block(struct inode *ip, uint bn, int alloc)
+{
+  char *page;
+
+  if((page = tpage(ip, bn / BPP, alloc)) == 0)
+    return 0;
+  return page + (bn % BPP) * BSIZE;
+}
+
+// 释放 t 的全部数据页和索引页
+static void
+tfree(struct tnode *t)
+{
+  void **leaf;
+
+  if(t->root == 0)
+    return;
+  for(int i = 0; i < NPTR; i++){
+    if((leaf = t->root[i]) == 0)
+      continue;
+    for(int j = 0; j < NPTR; j++){
+      if(leaf[j])
+        kfree(leaf[j]);
+    }
+    kfree(leaf);
+  }
+  kfree(t->root);
+  t->root = 0;
+}
+
+// 建立只含 "." 和 ".." 的根目录。在 log_freeze() 之后调用。
+int
+tmpfs_mount(void)
+{
+  struct tnode *t = &tmpfs.node[ROOTINO];
+  struct dirent *de;
+  char *blk;
+
+  memset(tmpfs.node, 0, sizeof(tmpfs.node));
+  if((blk = tzalloc()) == 0)
+    return -1;
+  if((t->root = tzalloc()) == 0 || (t->root[0] = tzalloc()) == 0){
+    kfree(blk);
+    tfree(t);
+    return -1;
+  }
+  ((void**)t->root[0])[0] = blk;
+  t->type = T_DIR;
+  t->nlink = 1;
+  t->size = BSIZE;
+
+  de = (struct dirent*)blk;
+  de->inum = ROOTINO;
+  de->reclen = DIRENT_SIZE(1);
+  de->namelen = 1;
+  de->name[0] = '.';
+  de = (struct dirent*)(blk + DIRENT_SIZE(1));
+  de->inum = ROOTINO;
+  de->reclen = BSIZE - DIRENT_SIZE(1);
+  de->namelen = 2;
+  de->name[0] = de->name[1] = '.';
+  return 0;
+}
+
+// 释放所有文件。在 log_freeze() 之后、没有 inode 引用时调用。
+void
+tmpfs_unmount(void)
+{
+  for(struct tnode *t = tmpfs.node; t < tmpfs.node + NTNODE; t++){
+    tfree(t);
+    t->type = 0;
+  }
+}
+
+// 分配一个空闲的 tnode，返回 inum；用完时返回 0
+uint
+tmpfs_ialloc(short type)
+{
+  struct tnode *t;
+
+  acquire(&tmpfs.lock);
+  for(t = tmpfs.node + ROOTINO + 1; t < tmpfs.node + NTNODE; t++){
+    if(t->type == 0){
+      memset(t, 0, sizeof(*t));
+      t->type = type;
+      release(&tmpfs.lock);
+      return t - tmpfs.node;
+    }
+  }
+  release(&tmpfs.lock);
+  return 0;
+}
+
+// ilock 中代替从磁盘读入 inode
+void
+tmpfs_load(struct inode *ip)
+{
+  struct tnode *t = &tmpfs.node[ip->inum];
+
+  ip->type = t->type;
+  ip->major = t->major;
+  ip->minor = t->minor;
+  ip->nlink = t->nlink;
+  ip->flags = 0;
+  ip->size = t->size;
+  memset(ip->addrs, 0, sizeof(ip->addrs));
+}
+
+// iupdate 中代替写回磁盘。type 为 0 时 tnode 回到空闲状态，
+// 此时 itrunc 已经释放了它的页。
+void
+tmpfs_store(struct inode *ip)
+{
+  struct tnode *t = &tmpfs.node[ip->inum];
+
+  acquire(&tmpfs.lock);
+  t->type = ip->type;
+  t->major = ip->major;
+  t->minor = ip->minor;
+  t->nlink = ip->nlink;
+  t->size = ip->size;
+  release(&tmpfs.lock);
+}
+
+// 释放 ip 的全部数据。Caller must hold ip->lock.
+void
+tmpfs_trunc(struct inode *ip)
+{
+  tfree(&tmpfs.node[ip->inum]);
+}
+
+// getdents 的 GD_STAT 用，不需要 inode 锁
+void
+tmpfs_stat(uint inum, uchar *type, uint *size)
+{
+  if(inum >= NTNODE)
+    return;
+  acquire(&tmpfs.lock);
+  *type = tmpfs.node[inum].type;
+  *size = tmpfs.node[inum].size;
+  release(&tmpfs.lock);
+}
+
+// 与 readi 相同，按页复制，空洞读出 0。Caller must hold ip->lock.
+int
+tmpfs_readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+{
+  uint tot, m;
+  char *page;
+
+  if(off > ip->size || off + n < off)
+    return 0;
+  if(off + n > ip->size)
+    n = ip->size - off;
+
+  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
+    m = min(n - tot, PGSIZE - off%PGSIZE);
+    if((page = tpage(ip, off/PGSIZE, 0)) == 0)
+      page = zeropage;
+    if(either_copyout(user_dst, dst, page + (off % PGSIZE), m) == -1)
+      break;
+  }
+  return tot;
+}
+
+// 与 writei 相同，按页复制。内存不足时只写入已分配到的部分。
+// Caller must hold ip->lock.
+int
+tmpfs_writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  uint tot, m;
+  char *page;
+
+  if(off > ip->size || off + n < off)
+    return -1;
+  if(off + n > MAXFILE*BSIZE)
+    return -1;
+
+  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
+    m = min(n - tot, PGSIZE - off%PGSIZE);
+    if((page = tpage(ip, off/PGSIZE, 1)) == 0)
+      break;
+    if(either_copyin(page + (off % PGSIZE), user_src, src, m) == -1){
+      tot = -1;
+      break;
+    }
+  }
+
+  if(off > ip->size)
+    ip->size = off;
+  iupdate(ip);
+  return tot;
+}
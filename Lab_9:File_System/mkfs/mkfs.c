@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <assert.h>
+
+#define stat xv6_stat  // avoid clash with host struct stat
+#include "kernel/types.h"
+#include "kernel/fs.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#define MKFS
+#include "kernel/lz.c"
+
+#ifndef static_assert
+#define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
+#endif
+
+// 这里仅列出修改和新增的部分，其余与原版 mkfs.c 相同
+
+// inode 号为 32 位后，inode 数随文件系统大小增长
+#define NINODES (FSSIZE / 8)
+
+// 位图之后是 reflink 用的块引用计数表，初始全为 0
+int nrefblocks = FSSIZE/RPB + 1;
+
+// 每个目录的内容先在内存中按块拼好，再一次写入。
+// 只有根目录，所以一个缓冲就够了。
+static char dirbuf[BSIZE];
+static int dirbufoff;
+static struct dirent *dirlast;
+
+void dirflush(uint);
+
+#define ZCSIZE (ZCLUSTER*BSIZE)
+
+// 从 fd 读入 n 字节，只在文件末尾读到的更少
+static int
+readfull(int fd, char *buf, int n)
+{
+  int cc, tot;
+
+  for(tot = 0; tot < n; tot += cc){
+    if((cc = read(fd, buf + tot, n - tot)) <= 0)
+      break;
+  }
+  return tot;
+}
+
+// 按 DI_COMPRESS 的格式追加文件内容，与内核 zwritei 写出的相同：
+// 压缩后能少占块的簇只写出 zhdr 和压缩数据所在的块，其余槽位留空。
+void
+zappend(uint inum, int fd)
+{
+  char buf[ZCSIZE], zbuf[ZCSIZE];
+  struct zhdr *zh = (struct zhdr*)zbuf;
+  struct dinode din;
+  int len, z, need, nblk;
+  uint base;
+
+  while((len = readfull(fd, buf, ZCSIZE)) > 0){
+    rinode(inum, &din);
+    base = xint(din.size);
+    need = (len + BSIZE - 1) / BSIZE;
+    memset(zbuf, 0, sizeof(zbuf));
+    z = lz_compress((uchar*)buf, len, (uchar*)(zh+1), ZCSIZE - sizeof(*zh));
+    if(z >= 0 && (nblk = (sizeof(*zh) + z + BSIZE - 1) / BSIZE) < need){
+      zh->zlen = xshort(z);
+      zh->rawlen = xshort(len);
+      iappend(inum, zbuf, nblk * BSIZE);
+      // 大小按解压后的长度计
+      rinode(inum, &din);
+      din.size = xint(base + len);
+      winode(inum, &din);
+    } else {
+      iappend(inum, buf, len);
+    }
+  }
+}
+
+// 追加一个目录项。当前块放不下时，把最后一项延伸到块尾后写出该块。
+void
+dirappend(uint dir, uint inum, char *name)
+{
+  struct dirent *de;
+  int n = strlen(name);
+  int len = DIRENT_SIZE(n);
+
+  assert(n <= DIRSIZ);
+  if(dirbufoff + len > BSIZE)
+    dirflush(dir);
+  de = (struct dirent*)(dirbuf + dirbufoff);
+  de->inum = xint(inum);
+  de->reclen = xshort(len);
+  de->namelen = n;
+  de->pad = 0;
+  memmove(de->name, name, n);
+  dirlast = de;
+  dirbufoff += len;
+}
+
+// 写出缓冲中的目录块，最后一项的 reclen 延伸到块尾
+void
+dirflush(uint dir)
+{
+  if(dirlast == 0)
+    return;
+  dirlast->reclen = xshort(BSIZE - ((char*)dirlast - dirbuf));
+  iappend(dir, dirbuf, BSIZE);
+  bzero(dirbuf, sizeof(dirbuf));
+  dirbufoff = 0;
+  dirlast = 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, cc, fd, compress;
+  uint rootino, inum;
+  char buf[BSIZE];
+  struct dinode din;
+
+
+  static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
+
+  if(argc < 2){
+    fprintf(stderr, "Usage: mkfs fs.img files... [-z files...]\n");
+    exit(1);
+  }
+
+  assert((BSIZE % sizeof(struct dinode)) == 0);
+
+  fsfd = open(argv[1], O_RDWR|O_CREAT|O_TRUNC, 0666);
+  if(fsfd < 0){
+    perror(argv[1]);
+    exit(1);
+  }
+
+  // 1 fs block = 1 disk sector
+  nmeta = 2 + nlog + ninodeblocks + nbitmap + nrefblocks;
+  nblocks = FSSIZE - nmeta;
+
+  sb.magic = FSMAGIC;
+  sb.size = xint(FSSIZE);
+  sb.nblocks = xint(nblocks);
+  sb.ninodes = xint(NINODES);
+  sb.nlog = xint(nlog);
+  sb.logstart = xint(2);
+  sb.inodestart = xint(2+nlog);
+  sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.refstart = xint(2+nlog+ninodeblocks+nbitmap);
+
+  printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u, refcount blocks %u) blocks %d total %d\n",
+         nmeta, nlog, ninodeblocks, nbitmap, nrefblocks, nblocks, FSSIZE);
+
+  freeblock = nmeta;     // the first free block that we can allocate
+
+  for(i = 0; i < FSSIZE; i++)
+    wsect(i, zeroes);
+
+  memset(buf, 0, sizeof(buf));
+  memmove(buf, &sb, sizeof(sb));
+  wsect(1, buf);
+
+  rootino = ialloc(T_DIR);
+  assert(rootino == ROOTINO);
+
+  dirappend(rootino, rootino, ".");
+  dirappend(rootino, rootino, "..");
+
+  compress = 0;
+  for(i = 2; i < argc; i++){
+    // -z 之后的文件以压缩格式（DI_COMPRESS）存放
+    if(strcmp(argv[i], "-z") == 0){
+      compress = 1;
+      continue;
+    }
+
+    // get rid of "user/"
+    char *shortname;
+    if(strncmp(argv[i], "user/", 5) == 0)
+      shortname = argv[i] + 5;
+    else
+      shortname = argv[i];
+    
+    assert(index(shortname, '/') == 0);
+
+    if((fd = open(argv[i], 0)) < 0){
+      perror(argv[i]);
+      exit(1);
+    }
+
+    // Skip leading _ in name when writing to file system.
+    // The binaries are named _rm, _cat, etc. to keep the
+    // build operating system from trying to execute them
+    // in place of system binaries like rm and cat.
+    if(shortname[0] == '_')
+      shortname += 1;
+
+    inum = ialloc(T_FILE);
+    if(compress){
+      rinode(inum, &din);
+      din.flags = xshort(DI_COMPRESS);
+      winode(inum, &din);
+    }
+
+    dirappend(rootino, inum, shortname);
+
+    if(compress){
+      zappend(inum, fd);
+    } else {
+      while((cc = read(fd, buf, sizeof(buf))) > 0)
+        iappend(inum, buf, cc);
+    }
+
+    close(fd);
+  }
+  // 目录总是整块写出，不再需要修正根目录的大小
+  dirflush(rootino);
+
+  balloc(freeblock);
+
+  exit(0);
+}
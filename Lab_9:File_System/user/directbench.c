@@ -0,0 +1,129 @@
+// directbench: copy a large file with and without O_DIRECT while
+// another process keeps stat'ing a set of small files, and report
+// the copy time and how many stat rounds the other process managed.
+// The stat workload only reads metadata blocks, so its rate shows how
+// much of its working set the copy evicted from the buffer cache.
+// usage: directbench [megabytes]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NMETA  128    // 元数据负载的文件数，其 inode 块和目录块约占 bcache 的一半
+#define CHUNK  8192
+
+static char buf[CHUNK] __attribute__((aligned(4096)));
+
+static void
+name(char *p, int i)
+{
+  strcpy(p, "dbm/f");
+  p[5] = 'a' + i / 26 / 26 % 26;
+  p[6] = 'a' + i / 26 % 26;
+  p[7] = 'a' + i % 26;
+  p[8] = 0;
+}
+
+static void
+setup(int mb)
+{
+  char path[16];
+  int fd, i;
+
+  mkdir("dbm");
+  for(i = 0; i < NMETA; i++){
+    name(path, i);
+    if((fd = open(path, O_CREATE|O_WRONLY)) < 0){
+      printf("directbench: cannot create %s\n", path);
+      exit(1);
+    }
+    close(fd);
+  }
+
+  if((fd = open("dbsrc", O_CREATE|O_WRONLY|O_TRUNC)) < 0){
+    printf("directbench: cannot create dbsrc\n");
+    exit(1);
+  }
+  memset(buf, 'x', CHUNK);
+  for(i = 0; i < mb * (1024*1024/CHUNK); i++){
+    if(write(fd, buf, CHUNK) != CHUNK){
+      printf("directbench: write dbsrc failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+// stat 所有小文件，直到父进程建立 dbdone
+static void
+meta(void)
+{
+  struct stat st;
+  char path[16];
+  int i, rounds, t0;
+
+  t0 = uptime();
+  for(rounds = 0; stat("dbdone", &st) < 0; rounds++){
+    for(i = 0; i < NMETA; i++){
+      name(path, i);
+      if(stat(path, &st) < 0){
+        printf("directbench: stat %s failed\n", path);
+        exit(1);
+      }
+    }
+  }
+  printf("directbench:   %d stat rounds in %d ticks\n", rounds, uptime() - t0);
+  exit(0);
+}
+
+static void
+run(char *label, int mode)
+{
+  int in, out, n, fd, t0, t1;
+
+  unlink("dbdone");
+  unlink("dbdst");
+  printf("directbench: %s\n", label);
+  if(fork() == 0)
+    meta();
+
+  t0 = uptime();
+  in = open("dbsrc", O_RDONLY|mode);
+  out = open("dbdst", O_CREATE|O_WRONLY|mode);
+  if(in < 0 || out < 0){
+    printf("directbench: open failed\n");
+    exit(1);
+  }
+  while((n = read(in, buf, CHUNK)) > 0){
+    if(write(out, buf, n) != n){
+      printf("directbench: write dbdst failed\n");
+      exit(1);
+    }
+  }
+  close(in);
+  close(out);
+  t1 = uptime();
+
+  if((fd = open("dbdone", O_CREATE|O_WRONLY)) >= 0)
+    close(fd);
+  wait(0);
+  printf("directbench:   copy %d ticks\n", t1 - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 64;
+
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  printf("directbench: %d MB file, %d metadata files\n", mb, NMETA);
+  setup(mb);
+  run("cached", 0);
+  run("direct", O_DIRECT);
+  unlink("dbsrc");
+  unlink("dbdst");
+  unlink("dbdone");
+  exit(0);
+}
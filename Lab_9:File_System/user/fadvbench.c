@@ -0,0 +1,104 @@
+// fadvbench: alternate sequential scans of a large file with lookups
+// in a small hot file, and report how long the scans and the lookups
+// take with and without fadvise hints on the scanned file.
+// usage: fadvbench [scan-kilobytes [rounds]]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define BSIZE 1024
+#define NHOT  12    // 热文件的块数，小于 bcache 的一半
+
+static char buf[BSIZE];
+
+static void
+mkfile(char *path, int nblk)
+{
+  int fd, i;
+
+  if((fd = open(path, O_CREATE|O_WRONLY|O_TRUNC)) < 0){
+    printf("fadvbench: cannot create %s\n", path);
+    exit(1);
+  }
+  for(i = 0; i < nblk; i++){
+    memset(buf, i, BSIZE);
+    if(write(fd, buf, BSIZE) != BSIZE){
+      printf("fadvbench: write %s failed\n", path);
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+static void
+readall(char *path, int advice)
+{
+  int fd;
+
+  if((fd = open(path, O_RDONLY)) < 0){
+    printf("fadvbench: cannot open %s\n", path);
+    exit(1);
+  }
+  if(advice >= 0)
+    fadvise(fd, 0, 0, advice);
+  while(read(fd, buf, BSIZE) == BSIZE)
+    ;
+  close(fd);
+}
+
+// advice 作用于扫描文件；FADV_DONTNEED 表示普通扫描后丢弃其缓存块
+static void
+run(char *label, int advice, int rounds)
+{
+  int i, t, scan = 0, look = 0;
+  int fd;
+
+  readall("fbhot", -1);
+  for(i = 0; i < rounds; i++){
+    t = uptime();
+    if(advice == FADV_DONTNEED){
+      readall("fbscan", FADV_NORMAL);
+      if((fd = open("fbscan", O_RDONLY)) >= 0){
+        fadvise(fd, 0, 0, FADV_DONTNEED);
+        close(fd);
+      }
+    } else {
+      readall("fbscan", advice);
+    }
+    scan += uptime() - t;
+
+    t = uptime();
+    readall("fbhot", -1);
+    look += uptime() - t;
+  }
+  printf("fadvbench: %s: scans %d ticks, lookups %d ticks\n", label, scan, look);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kb = 4096, rounds = 8, fd;
+
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+
+  mkfile("fbhot", NHOT);
+  mkfile("fbscan", kb);
+  printf("fadvbench: %d KB scan, %d block hot file, %d rounds\n", kb, NHOT, rounds);
+
+  run("normal", FADV_NORMAL, rounds);
+  run("sequential", FADV_SEQUENTIAL, rounds);
+  run("dontneed", FADV_DONTNEED, rounds);
+
+  // 提示保存在 inode 上，恢复后再删除
+  if((fd = open("fbscan", O_RDONLY)) >= 0){
+    fadvise(fd, 0, 0, FADV_NORMAL);
+    close(fd);
+  }
+  unlink("fbscan");
+  unlink("fbhot");
+  exit(0);
+}
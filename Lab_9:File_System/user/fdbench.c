@@ -0,0 +1,49 @@
+// fdbench: open many descriptors in one process, then close them,
+// and report the time for each phase.  Also checks that a freed
+// descriptor in the middle of the table is the next one handed out.
+// usage: fdbench [descriptors]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int n = 10000, i, fd, first, t0;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if((fd = open("fbfile", O_CREATE|O_WRONLY)) < 0){
+    printf("fdbench: cannot create fbfile\n");
+    exit(1);
+  }
+  close(fd);
+
+  t0 = uptime();
+  first = -1;
+  for(i = 0; i < n; i++){
+    if((fd = open("fbfile", O_RDONLY)) < 0){
+      printf("fdbench: open %d failed\n", i);
+      exit(1);
+    }
+    if(first < 0)
+      first = fd;
+  }
+  printf("fdbench: %d opens in %d ticks\n", n, uptime() - t0);
+
+  // 关掉中间的一个，再打开应当拿到同一个描述符
+  close(first + n/2);
+  if((fd = open("fbfile", O_RDONLY)) != first + n/2){
+    printf("fdbench: reopen got fd %d, expected %d\n", fd, first + n/2);
+    exit(1);
+  }
+
+  t0 = uptime();
+  for(i = 0; i < n; i++)
+    close(first + i);
+  printf("fdbench: %d closes in %d ticks\n", n, uptime() - t0);
+
+  unlink("fbfile");
+  exit(0);
+}
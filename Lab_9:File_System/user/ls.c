@@ -0,0 +1,77 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+
+char*
+fmtname(char *path)
+{
+  static char buf[DIRSIZ+1];
+  char *p;
+
+  // Find first character after last slash.
+  for(p=path+strlen(path); p >= path && *p != '/'; p--)
+    ;
+  p++;
+
+  // Return blank-padded name.
+  if(strlen(p) >= 14)
+    return p;
+  memmove(buf, p, strlen(p));
+  memset(buf+strlen(p), ' ', 14-strlen(p));
+  buf[14] = 0;
+  return buf;
+}
+
+void
+ls(char *path)
+{
+  static char blk[1024];
+  int fd, n, off;
+  struct gdent *g;
+  struct stat st;
+
+  if((fd = open(path, 0)) < 0){
+    fprintf(2, "ls: cannot open %s\n", path);
+    return;
+  }
+
+  if(fstat(fd, &st) < 0){
+    fprintf(2, "ls: cannot stat %s\n", path);
+    close(fd);
+    return;
+  }
+
+  switch(st.type){
+  case T_FILE:
+    printf("%s %d %d %d\n", fmtname(path), st.type, st.ino, st.size);
+    break;
+
+  case T_DIR:
+    // 一次 getdents 取回多项及其类型和大小，不再逐项 stat
+    while((n = getdents(fd, blk, sizeof(blk), GD_STAT)) > 0){
+      for(off = 0; off < n; off += g->reclen){
+        g = (struct gdent*)(blk + off);
+        printf("%s %d %d %d\n", fmtname(g->name), g->type, g->inum, g->size);
+      }
+    }
+    if(n < 0)
+      printf("ls: cannot read %s\n", path);
+    break;
+  }
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+
+  if(argc < 2){
+    ls(".");
+    exit(0);
+  }
+  for(i=1; i<argc; i++)
+    ls(argv[i]);
+  exit(0);
+}
@@ -0,0 +1,93 @@
+// lsbench: fill a directory with many empty files and time an
+// "ls -l" style listing of it: getdents followed by a stat of every
+// entry, and getdents with GD_STAT, which returns the stat fields.
+// usage: lsbench [entries]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+static char blk[1024];
+
+static void
+name(char *p, int i)
+{
+  int k;
+
+  p[0] = 'f';
+  for(k = 5; k >= 1; k--, i /= 10)
+    p[k] = '0' + i % 10;
+  p[6] = 0;
+}
+
+static int
+list(int flags)
+{
+  struct gdent *g;
+  struct stat st;
+  int fd, n, off, cnt = 0;
+
+  if((fd = open(".", O_RDONLY)) < 0){
+    printf("lsbench: cannot open directory\n");
+    exit(1);
+  }
+  while((n = getdents(fd, blk, sizeof(blk), flags)) > 0){
+    for(off = 0; off < n; off += g->reclen){
+      g = (struct gdent*)(blk + off);
+      if(!(flags & GD_STAT) && stat(g->name, &st) < 0){
+        printf("lsbench: cannot stat %s\n", g->name);
+        exit(1);
+      }
+      cnt++;
+    }
+  }
+  close(fd);
+  return cnt;
+}
+
+static void
+run(char *label, int flags)
+{
+  int t0, cnt;
+
+  t0 = uptime();
+  cnt = list(flags);
+  printf("lsbench: %s: %d entries in %d ticks\n", label, cnt, uptime() - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = 5000, i, fd;
+  char path[8];
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  if(mkdir("lsb") < 0 || chdir("lsb") < 0){
+    printf("lsbench: cannot create lsb\n");
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    name(path, i);
+    if((fd = open(path, O_CREATE|O_WRONLY)) < 0){
+      printf("lsbench: cannot create %s\n", path);
+      exit(1);
+    }
+    close(fd);
+  }
+
+  run("getdents+stat", 0);
+  run("getdents+stat again", 0);
+  run("getdents GD_STAT", GD_STAT);
+
+  for(i = 0; i < n; i++){
+    name(path, i);
+    unlink(path);
+  }
+  chdir("..");
+  unlink("lsb");
+  exit(0);
+}
@@ -0,0 +1,86 @@
+// openbench: open and close a file at the bottom of a deep directory
+// tree from one process and then from several at once, and report
+// the time each takes.
+// usage: openbench [processes [opens-per-process [depth]]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+static char path[128];
+
+static void
+opens(int n)
+{
+  int i, fd;
+
+  for(i = 0; i < n; i++){
+    if((fd = open(path, O_RDONLY)) < 0){
+      printf("openbench: cannot open %s\n", path);
+      exit(1);
+    }
+    close(fd);
+  }
+}
+
+static void
+run(int nproc, int n)
+{
+  int i, t0;
+
+  t0 = uptime();
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      opens(n);
+      exit(0);
+    }
+  }
+  for(i = 0; i < nproc; i++)
+    wait(0);
+  printf("openbench: %d processes x %d opens in %d ticks\n", nproc, n, uptime() - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = NCPU, n = 1000, depth = 8, i, fd;
+  char *p;
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    n = atoi(argv[2]);
+  if(argc > 3)
+    depth = atoi(argv[3]);
+  if(depth < 1 || depth > 30){
+    printf("openbench: depth must be 1 to 30\n");
+    exit(1);
+  }
+
+  // ob/d/d/.../d/f
+  strcpy(path, "ob");
+  mkdir(path);
+  p = path + 2;
+  for(i = 1; i < depth; i++){
+    strcpy(p, "/d");
+    p += 2;
+    mkdir(path);
+  }
+  strcpy(p, "/f");
+  if((fd = open(path, O_CREATE|O_WRONLY)) < 0){
+    printf("openbench: cannot create %s\n", path);
+    exit(1);
+  }
+  close(fd);
+
+  run(1, n);
+  run(nproc, n);
+
+  unlink(path);
+  for(i = 0; i < depth; i++, p -= 2){
+    *p = 0;
+    unlink(path);
+  }
+  exit(0);
+}
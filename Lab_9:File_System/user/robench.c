@@ -0,0 +1,125 @@
+// robench: build a small image on the ramdisk, then run a read-heavy
+// workload (path lookups, stats and whole-file reads from several
+// processes) against it mounted read-write and mounted read-only.
+// usage: robench [processes [rounds]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NDIR    3
+#define NPERDIR 16
+#define FSIZE   4096
+
+static char *dirs[NDIR] = { "/rob/bin", "/rob/lib", "/rob/etc" };
+static char buf[FSIZE];
+
+static void
+path(char *p, int d, int f)
+{
+  strcpy(p, dirs[d]);
+  p += strlen(p);
+  p[0] = '/';
+  p[1] = 'f';
+  p[2] = '0' + f / 10;
+  p[3] = '0' + f % 10;
+  p[4] = 0;
+}
+
+static void
+populate(void)
+{
+  char p[32];
+  int d, f, fd;
+
+  for(d = 0; d < NDIR; d++){
+    if(mkdir(dirs[d]) < 0){
+      printf("robench: cannot create %s\n", dirs[d]);
+      exit(1);
+    }
+    for(f = 0; f < NPERDIR; f++){
+      path(p, d, f);
+      if((fd = open(p, O_CREATE|O_WRONLY)) < 0){
+        printf("robench: cannot create %s\n", p);
+        exit(1);
+      }
+      memset(buf, d * NPERDIR + f, FSIZE);
+      write(fd, buf, FSIZE);
+      close(fd);
+    }
+  }
+}
+
+// 像启动时那样：逐个 stat、打开、读完每个文件
+static void
+reader(int rounds)
+{
+  struct stat st;
+  char p[32];
+  int r, d, f, fd;
+
+  for(r = 0; r < rounds; r++){
+    for(d = 0; d < NDIR; d++){
+      for(f = 0; f < NPERDIR; f++){
+        path(p, d, f);
+        if(stat(p, &st) < 0 || (fd = open(p, O_RDONLY)) < 0){
+          printf("robench: cannot open %s\n", p);
+          exit(1);
+        }
+        while(read(fd, buf, FSIZE) > 0)
+          ;
+        close(fd);
+      }
+    }
+  }
+  exit(0);
+}
+
+static void
+run(char *label, int flags, int nproc, int rounds)
+{
+  int i, t0;
+
+  if(mount(RAMDEV, "/rob", flags) < 0){
+    printf("robench: cannot mount the ramdisk %s\n", label);
+    exit(1);
+  }
+  t0 = uptime();
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0)
+      reader(rounds);
+  }
+  for(i = 0; i < nproc; i++)
+    wait(0);
+  printf("robench: %s: %d processes x %d rounds in %d ticks\n",
+         label, nproc, rounds, uptime() - t0);
+  if(umount("/rob") < 0){
+    printf("robench: cannot unmount /rob\n");
+    exit(1);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = 4, rounds = 50;
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+
+  mkdir("/rob");
+  if(mount(RAMDEV, "/rob", MNT_FORMAT) < 0){
+    printf("robench: cannot format the ramdisk\n");
+    exit(1);
+  }
+  populate();
+  umount("/rob");
+
+  run("read-write", 0, nproc, rounds);
+  run("read-only", MNT_RDONLY, nproc, rounds);
+  exit(0);
+}
@@ -0,0 +1,68 @@
+// statbench: fstat a file as fast as possible, first while it is idle
+// and then while another process keeps appending to it, and report
+// the time each run takes.
+// usage: statbench [stats]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define BSIZE   1024
+#define MAXSIZE (256*1024)   // 追加到这么大就截断重来，避免占满磁盘
+
+static char buf[BSIZE];
+
+static void
+appender(void)
+{
+  int fd, off;
+
+  for(;;){
+    if((fd = open("sbfile", O_WRONLY|O_TRUNC)) < 0)
+      exit(1);
+    for(off = 0; off < MAXSIZE; off += BSIZE)
+      write(fd, buf, BSIZE);
+    close(fd);
+  }
+}
+
+static void
+run(char *label, int fd, int n)
+{
+  struct stat st;
+  int i, t0;
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(fstat(fd, &st) < 0){
+      printf("statbench: fstat failed\n");
+      exit(1);
+    }
+  }
+  printf("statbench: %s: %d stats in %d ticks\n", label, n, uptime() - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = 100000, fd, pid;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if((fd = open("sbfile", O_CREATE|O_RDWR)) < 0){
+    printf("statbench: cannot create sbfile\n");
+    exit(1);
+  }
+
+  run("idle", fd, n);
+  if((pid = fork()) == 0)
+    appender();
+  run("appending", fd, n);
+  kill(pid);
+  wait(0);
+
+  close(fd);
+  unlink("sbfile");
+  exit(0);
+}
@@ -0,0 +1,101 @@
+// tmpbench: run a compile-style temp file workload, in which each
+// step writes an intermediate file, reads it back, writes an output
+// file and deletes the intermediate, and the outputs are deleted at
+// the end, once in a tmpfs mounted on /tmp and once on the disk.
+// usage: tmpbench [units [rounds]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define SSIZE (8*1024)   // 中间文件大小
+#define OSIZE (4*1024)   // 输出文件大小
+
+static char buf[SSIZE];
+
+static void
+fname(char *p, char *dir, int i, char ext)
+{
+  strcpy(p, dir);
+  p += strlen(p);
+  p[0] = '/';
+  p[1] = 'u';
+  p[2] = '0' + i / 10 % 10;
+  p[3] = '0' + i % 10;
+  p[4] = '.';
+  p[5] = ext;
+  p[6] = 0;
+}
+
+static void
+put(char *path, int n)
+{
+  int fd;
+
+  if((fd = open(path, O_CREATE|O_WRONLY|O_TRUNC)) < 0 || write(fd, buf, n) != n){
+    printf("tmpbench: cannot write %s\n", path);
+    exit(1);
+  }
+  close(fd);
+}
+
+static void
+run(char *dir, int units, int rounds)
+{
+  char s[32], o[32];
+  int r, i, fd, t0;
+
+  t0 = uptime();
+  for(r = 0; r < rounds; r++){
+    for(i = 0; i < units; i++){
+      fname(s, dir, i, 's');
+      fname(o, dir, i, 'o');
+      put(s, SSIZE);
+      if((fd = open(s, O_RDONLY)) < 0){
+        printf("tmpbench: cannot open %s\n", s);
+        exit(1);
+      }
+      while(read(fd, buf, SSIZE) > 0)
+        ;
+      close(fd);
+      put(o, OSIZE);
+      unlink(s);
+    }
+    for(i = 0; i < units; i++){
+      fname(o, dir, i, 'o');
+      unlink(o);
+    }
+  }
+  printf("tmpbench: %s: %d rounds of %d units in %d ticks\n",
+         dir, rounds, units, uptime() - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct stat st;
+  int units = 20, rounds = 10;
+
+  if(argc > 1)
+    units = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(units > 100)
+    units = 100;
+
+  // /tmp 可能已经挂载了 tmpfs
+  mkdir("/tmp");
+  mount(TMPDEV, "/tmp", 0);
+  if(stat("/tmp", &st) < 0 || st.dev != TMPDEV){
+    printf("tmpbench: cannot mount tmpfs on /tmp\n");
+    exit(1);
+  }
+  mkdir("/tbdisk");
+
+  run("/tmp", units, rounds);
+  run("/tbdisk", units, rounds);
+  unlink("/tbdisk");
+  exit(0);
+}
@@ -0,0 +1,122 @@
+// zbench: write and read back a compressible file with and without
+// O_COMPRESS, and report the compression ratio and the time taken.
+// The ratio is worked out with the kernel's compressor and cluster
+// layout, so it counts the data blocks a compressed file occupies.
+// usage: zbench [kilobytes]
+
+#include "kernel/types.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+#define MKFS
+#include "kernel/lz.c"
+
+#define ZCSIZE (ZCLUSTER*BSIZE)
+
+static char buf[ZCSIZE], zbuf[ZCSIZE], rbuf[ZCSIZE];
+
+static int
+putnum(char *p, uint n, int width)
+{
+  int i;
+
+  for(i = width - 1; i >= 0; i--){
+    p[i] = '0' + n % 10;
+    n /= 10;
+  }
+  return width;
+}
+
+// 第 c 簇的内容：类似日志的文本行，压缩率与真实数据相近
+static void
+gen(uint c, char *p)
+{
+  static char line[] = "id=000000 user=u0000 status=active bytes=00000000\n";
+  int off, n = sizeof(line) - 1;
+  uint i = c * (ZCSIZE / n);
+
+  for(off = 0; off < ZCSIZE; off += n, i++){
+    putnum(line + 3, i, 6);
+    putnum(line + 16, i % 1000, 4);
+    putnum(line + 41, i * 2654435761U % 100000000, 8);
+    memmove(p + off, line, off + n <= ZCSIZE ? n : ZCSIZE - off);
+  }
+}
+
+// 与内核 zwritei 相同的规则计算一簇占用的块数
+static int
+cblocks(char *p)
+{
+  struct zhdr *zh = (struct zhdr*)zbuf;
+  int z, nblk, need = ZCSIZE / BSIZE;
+
+  z = lz_compress((uchar*)p, ZCSIZE, (uchar*)(zh+1), ZCSIZE - sizeof(*zh));
+  if(z >= 0 && (nblk = (sizeof(*zh) + z + BSIZE - 1) / BSIZE) < need)
+    return nblk;
+  return need;
+}
+
+static void
+run(char *label, int mode, int nclust)
+{
+  int fd, c, t0, t1, t2;
+
+  unlink("zbfile");
+  t0 = uptime();
+  if((fd = open("zbfile", O_CREATE|O_WRONLY|mode)) < 0){
+    printf("zbench: cannot create zbfile\n");
+    exit(1);
+  }
+  for(c = 0; c < nclust; c++){
+    gen(c, buf);
+    if(write(fd, buf, ZCSIZE) != ZCSIZE){
+      printf("zbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+  t1 = uptime();
+
+  if((fd = open("zbfile", O_RDONLY)) < 0){
+    printf("zbench: cannot open zbfile\n");
+    exit(1);
+  }
+  for(c = 0; c < nclust; c++){
+    gen(c, buf);
+    if(read(fd, rbuf, ZCSIZE) != ZCSIZE || memcmp(buf, rbuf, ZCSIZE) != 0){
+      printf("zbench: %s: cluster %d reads back wrong\n", label, c);
+      exit(1);
+    }
+  }
+  close(fd);
+  t2 = uptime();
+
+  printf("zbench: %s: write %d ticks, read %d ticks\n", label, t1 - t0, t2 - t1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kb = 2048, nclust, c, used = 0;
+
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if((nclust = kb * 1024 / ZCSIZE) <= 0){
+    printf("zbench: need at least %d KB\n", ZCSIZE / 1024);
+    exit(1);
+  }
+
+  for(c = 0; c < nclust; c++){
+    gen(c, buf);
+    used += cblocks(buf);
+  }
+  printf("zbench: %d KB in %d data blocks, ratio %d.%d%d\n", kb, used,
+         nclust * ZCLUSTER / used,
+         nclust * ZCLUSTER * 10 / used % 10,
+         nclust * ZCLUSTER * 100 / used % 10);
+
+  run("plain", 0, nclust);
+  run("compressed", O_COMPRESS, nclust);
+  unlink("zbfile");
+  exit(0);
+}